@@ -0,0 +1,280 @@
+//
+//  CoreBenchmark.cpp
+//
+//  Measures the animation core without GL: for every model, the time to import it, the memory it holds once imported
+//  and the time to evaluate one pose of its first clip. Synthetic rigs of thousands of bones are measured as well,
+//  built in memory as Assimp scenes, so that the cost per bone shows beyond the size of the models in resources.
+//
+//  Usage: core-benchmark [model files...], for instance core-benchmark *.dae *.DAE *.fbx *.obj *.md5mesh in the build
+//  folder, where the models of resources are copied
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "SkinnedModelData.h"
+#include "PoseEvaluator.h"
+
+// Bones of the synthetic rigs
+static const int SYNTHETIC_RIG_BONES[] = { 1024, 4096 };
+
+// Rotation keys per channel of the synthetic clip, at 30 per second
+#define SYNTHETIC_KEYS 60
+
+// Poses evaluated per model, played forward at 60 frames per second
+#define NUM_POSES 2000
+
+// Resident memory of the process in bytes, 0 if unknown
+static size_t residentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#elif defined(__APPLE__)
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) == KERN_SUCCESS) {
+        return info.resident_size;
+    }
+    return 0;
+#else
+    size_t pages = 0;
+    size_t residentPages = 0;
+    FILE* statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+    if (std::fscanf(statm, "%zu %zu", &pages, &residentPages) != 2) {
+        residentPages = 0;
+    }
+    std::fclose(statm);
+    return residentPages * (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// A tree of numBones bones, four children per bone, with one triangle skinned to each bone and its parent and one
+// clip rotating every bone. The arrays are allocated with new[] so that the scene's destructor frees them.
+static aiScene* buildSyntheticRig(int numBones)
+{
+    aiScene* scene = new aiScene();
+    
+    std::vector<aiNode*> bones(numBones);
+    std::vector<int> parents(numBones);
+    std::vector<aiVector3D> positions(numBones);
+    
+    aiNode* root = new aiNode();
+    root->mName.Set("root");
+    for (int i = 0; i < numBones; i++) {
+        parents[i] = i > 0 ? (i - 1) / 4 : -1;
+        bones[i] = new aiNode();
+        bones[i]->mName.Set("bone" + std::to_string(i));
+        
+        // Children spread around their parent and one unit above it
+        const aiVector3D offset(i > 0 ? (float)((i - 1) % 4) - 1.5f : 0.0f, 1.0f, 0.0f);
+        bones[i]->mTransformation.a4 = offset.x;
+        bones[i]->mTransformation.b4 = offset.y;
+        bones[i]->mTransformation.c4 = offset.z;
+        positions[i] = parents[i] >= 0 ? positions[parents[i]] + offset : offset;
+    }
+    for (int i = 0; i < numBones; i++) {
+        aiNode* parent = parents[i] >= 0 ? bones[parents[i]] : root;
+        bones[i]->mParent = parent;
+        parent->mNumChildren++;
+    }
+    root->mChildren = new aiNode*[root->mNumChildren];
+    for (int i = 0; i < numBones; i++) {
+        if (bones[i]->mNumChildren > 0) {
+            bones[i]->mChildren = new aiNode*[bones[i]->mNumChildren];
+            bones[i]->mNumChildren = 0;
+        }
+    }
+    root->mNumChildren = 0;
+    for (int i = 0; i < numBones; i++) {
+        aiNode* parent = bones[i]->mParent;
+        parent->mChildren[parent->mNumChildren++] = bones[i];
+    }
+    root->mNumMeshes = 1;
+    root->mMeshes = new unsigned[1];
+    root->mMeshes[0] = 0;
+    scene->mRootNode = root;
+    
+    aiMesh* mesh = new aiMesh();
+    mesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    mesh->mNumVertices = 3 * numBones;
+    mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+    mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+    mesh->mNumFaces = numBones;
+    mesh->mFaces = new aiFace[numBones];
+    mesh->mNumBones = numBones;
+    mesh->mBones = new aiBone*[numBones];
+    for (int i = 0; i < numBones; i++) {
+        for (int v = 0; v < 3; v++) {
+            mesh->mVertices[3 * i + v] = positions[i] + aiVector3D(v == 1 ? 0.2f : 0.0f, v == 2 ? 0.2f : 0.0f, 0.0f);
+            mesh->mNormals[3 * i + v] = aiVector3D(0.0f, 0.0f, 1.0f);
+        }
+        mesh->mFaces[i].mNumIndices = 3;
+        mesh->mFaces[i].mIndices = new unsigned[3];
+        for (int v = 0; v < 3; v++) {
+            mesh->mFaces[i].mIndices[v] = 3 * i + v;
+        }
+        
+        // The bind pose only translates, so the offset matrix moves the bone back to the origin
+        aiBone* bone = new aiBone();
+        bone->mName = bones[i]->mName;
+        bone->mOffsetMatrix.a4 = -positions[i].x;
+        bone->mOffsetMatrix.b4 = -positions[i].y;
+        bone->mOffsetMatrix.c4 = -positions[i].z;
+        mesh->mBones[i] = bone;
+    }
+    // Every vertex gets 0.75 of its own bone and 0.25 of the parent, or all of its bone at the root
+    std::vector< std::vector<aiVertexWeight> > weights(numBones);
+    for (int i = 0; i < numBones; i++) {
+        for (int v = 0; v < 3; v++) {
+            aiVertexWeight weight;
+            weight.mVertexId = 3 * i + v;
+            weight.mWeight = parents[i] >= 0 ? 0.75f : 1.0f;
+            weights[i].push_back(weight);
+            if (parents[i] >= 0) {
+                weight.mWeight = 0.25f;
+                weights[parents[i]].push_back(weight);
+            }
+        }
+    }
+    for (int i = 0; i < numBones; i++) {
+        mesh->mBones[i]->mNumWeights = (unsigned)weights[i].size();
+        mesh->mBones[i]->mWeights = new aiVertexWeight[weights[i].size()];
+        std::copy(weights[i].begin(), weights[i].end(), mesh->mBones[i]->mWeights);
+    }
+    scene->mNumMeshes = 1;
+    scene->mMeshes = new aiMesh*[1];
+    scene->mMeshes[0] = mesh;
+    
+    aiAnimation* animation = new aiAnimation();
+    animation->mName.Set("sway");
+    animation->mTicksPerSecond = 30.0;
+    animation->mDuration = SYNTHETIC_KEYS - 1;
+    animation->mNumChannels = numBones;
+    animation->mChannels = new aiNodeAnim*[numBones];
+    for (int i = 0; i < numBones; i++) {
+        aiNodeAnim* channel = new aiNodeAnim();
+        channel->mNodeName = bones[i]->mName;
+        channel->mNumPositionKeys = 1;
+        channel->mPositionKeys = new aiVectorKey[1];
+        channel->mPositionKeys[0].mTime = 0.0;
+        channel->mPositionKeys[0].mValue = aiVector3D(bones[i]->mTransformation.a4, bones[i]->mTransformation.b4, bones[i]->mTransformation.c4);
+        channel->mNumScalingKeys = 1;
+        channel->mScalingKeys = new aiVectorKey[1];
+        channel->mScalingKeys[0].mTime = 0.0;
+        channel->mScalingKeys[0].mValue = aiVector3D(1.0f, 1.0f, 1.0f);
+        
+        // A sway about z, shifted along the tree so that neighbouring bones differ
+        channel->mNumRotationKeys = SYNTHETIC_KEYS;
+        channel->mRotationKeys = new aiQuatKey[SYNTHETIC_KEYS];
+        for (int k = 0; k < SYNTHETIC_KEYS; k++) {
+            const float angle = 0.3f * std::sin(6.2831853f * k / (SYNTHETIC_KEYS - 1) + 0.1f * i);
+            channel->mRotationKeys[k].mTime = k;
+            channel->mRotationKeys[k].mValue = aiQuaternion(std::cos(0.5f * angle), 0.0f, 0.0f, std::sin(0.5f * angle));
+        }
+        animation->mChannels[i] = channel;
+    }
+    scene->mNumAnimations = 1;
+    scene->mAnimations = new aiAnimation*[1];
+    scene->mAnimations[0] = animation;
+    
+    return scene;
+}
+
+struct Result {
+    std::string name;
+    int numBones;
+    int numClips;
+    double importTime;      // ms
+    double residentMB;      // growth of the process while importing, including what the importer did not give back
+    double poseTime;        // ns per pose, 0 without clips
+};
+
+// Nanoseconds per pose of the first clip of model
+static double poseTime(const SkinnedModelData &model)
+{
+    if (model.getNumClips() == 0) {
+        return 0.0;
+    }
+    
+    PoseEvaluator pose(model);
+    std::vector<Affine3x4> palette;
+    
+    // The first pose sizes the scratch space
+    pose.evaluate(0, 0.0f, palette);
+    
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < NUM_POSES; i++) {
+        pose.evaluate(0, i / 60.0f, palette);
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    
+    return std::chrono::duration<double, std::nano>(end - start).count() / NUM_POSES;
+}
+
+static Result measure(const std::string &name, const aiScene* syntheticScene)
+{
+    Result result;
+    result.name = name;
+    
+    const size_t residentBefore = residentBytes();
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<SkinnedModelData> model(syntheticScene ? new SkinnedModelData(syntheticScene, name) : new SkinnedModelData(name, 1.0));
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    const size_t residentAfter = residentBytes();
+    
+    result.importTime = std::chrono::duration<double, std::milli>(end - start).count();
+    result.residentMB = residentAfter > residentBefore ? (residentAfter - residentBefore) / (1024.0 * 1024.0) : 0.0;
+    result.numBones = model->isLoaded() ? model->getNumBones() : -1;
+    result.numClips = model->isLoaded() ? model->getNumClips() : 0;
+    result.poseTime = model->isLoaded() ? poseTime(*model) : 0.0;
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<Result> results;
+    
+    for (int i = 1; i < argc; i++) {
+        results.push_back(measure(argv[i], nullptr));
+    }
+    
+    for (int numBones : SYNTHETIC_RIG_BONES) {
+        std::unique_ptr<aiScene> scene(buildSyntheticRig(numBones));
+        results.push_back(measure("synthetic rig " + std::to_string(numBones), scene.get()));
+    }
+    
+    // The importer prints while it works, so the table comes last
+    std::printf("\n%d poses of the first clip per model\n", NUM_POSES);
+    std::printf("%-40s %8s %8s %10s %12s %10s %12s\n", "model", "bones", "clips", "import ms", "resident MB", "ns/pose", "ns/bone");
+    for (const Result &result : results) {
+        if (result.numBones < 0) {
+            std::printf("%-40s %8s\n", result.name.c_str(), "failed");
+            continue;
+        }
+        std::printf("%-40s %8d %8d %10.2f %12.2f %10.0f %12.1f\n", result.name.c_str(), result.numBones, result.numClips, result.importTime,
+                    result.residentMB, result.poseTime, result.numBones > 0 ? result.poseTime / result.numBones : 0.0);
+    }
+    
+    return 0;
+}
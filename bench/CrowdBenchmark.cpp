@@ -0,0 +1,89 @@
+//
+//  CrowdBenchmark.cpp
+//
+//  Evaluates the poses of a crowd of instances sharing one model with 1 to N threads of the JobSystem, and checks
+//  that every thread count produces the same palettes. With a bake rate the instances play from a PaletteCache.
+//
+//  Usage: crowd-benchmark [model file, defaults to boblampclean.md5mesh] [number of instances, defaults to 1000]
+//                         [frames per second of baked palettes, evaluates the clips when omitted]
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "AnimationInstance.h"
+#include "JobSystem.h"
+#include "PaletteCache.h"
+
+int main(int argc, char** argv)
+{
+    const std::string filename = argc > 1 ? argv[1] : "boblampclean.md5mesh";
+    const int numInstances = argc > 2 ? std::atoi(argv[2]) : 1000;
+    const float bakeRate = argc > 3 ? (float)std::atof(argv[3]) : 0.0f;
+    const int numFrames = 100;
+    
+    // Only the CPU side of the model is needed, so no GL context is created
+    std::shared_ptr<const AnimatedModelAsset> asset(new AnimatedModelAsset(filename, 1.0, glm::vec4(1.0), false));
+    if (asset->getNumClips() == 0) {
+        std::printf("%s has no animation\n", filename.c_str());
+        return 1;
+    }
+    
+    std::shared_ptr<const PaletteCache> paletteCache;
+    if (bakeRate > 0.0f) {
+        paletteCache = std::make_shared<PaletteCache>(asset, bakeRate);
+    }
+    
+    std::vector<std::unique_ptr<AnimationInstance> > crowd;
+    std::vector<AnimationInstance*> instances;
+    for (int i = 0; i < numInstances; i++) {
+        crowd.push_back(std::unique_ptr<AnimationInstance>(new AnimationInstance(asset)));
+        crowd.back()->setPaletteCache(paletteCache);
+        instances.push_back(crowd.back().get());
+    }
+    
+    std::printf("\n%s: %d instances, %d nodes, %d bones, %d frames per thread count, %s\n\n", filename.c_str(), numInstances, asset->getSkeleton().getNumNodes(), asset->getNumBones(), numFrames,
+                paletteCache ? "baked palettes" : "evaluated poses");
+    std::printf("%8s %12s %10s %12s\n", "threads", "ms/frame", "speedup", "palettes");
+    
+    const int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    double singleThreadTime = 0.0;
+    std::vector<Affine3x4> reference;
+    
+    for (int numThreads = 1; numThreads <= maxThreads; numThreads++) {
+        JobSystem jobs(numThreads);
+        
+        // Every instance plays the clip offset in time, the same times for every thread count
+        std::vector<float> times(numInstances);
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        for (int frame = 0; frame < numFrames; frame++) {
+            for (int i = 0; i < numInstances; i++) {
+                times[i] = frame / 90.0f + i * 0.37f;
+            }
+            AnimationInstance::updateAll(instances, times, jobs);
+        }
+        std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+        const double frameTime = std::chrono::duration<double, std::milli>(end - start).count() / numFrames;
+        
+        // Compare the palettes of the last frame with the single threaded run
+        std::vector<Affine3x4> palettes;
+        for (int i = 0; i < numInstances; i++) {
+            palettes.insert(palettes.end(), instances[i]->getPalette().begin(), instances[i]->getPalette().end());
+        }
+        if (numThreads == 1) {
+            singleThreadTime = frameTime;
+            reference = palettes;
+        }
+        const bool identical = palettes.size() == reference.size() && (palettes.empty() || std::memcmp(&palettes[0], &reference[0], sizeof(Affine3x4) * palettes.size()) == 0);
+        
+        std::printf("%8d %12.3f %9.2fx %12s\n", numThreads, frameTime, singleThreadTime / frameTime, identical ? "identical" : "DIFFERENT");
+    }
+    
+    return 0;
+}
@@ -0,0 +1,132 @@
+//
+//  KeyframeSearchBenchmark.cpp
+//
+//  Measures the cost of locating keyframes at different positions of a clip, comparing the old linear scan with
+//  the binary search and the playback cursor from KeyframeSearch.h.
+//
+//  Usage: keyframe-search-benchmark [model file, defaults to boblampclean.md5mesh]
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "KeyframeSearch.h"
+
+// The search AnimatedModel used before KeyframeSearch.h
+template <typename Key>
+static unsigned int findKeyLinear(float AnimationTime, const Key* keys, unsigned int numKeys)
+{
+    for (unsigned int i = 0; i < numKeys - 1; i++) {
+        if (AnimationTime < (float)keys[i + 1].mTime) {
+            return i;
+        }
+    }
+    return numKeys - 2;
+}
+
+struct ChannelCursor {
+    unsigned int position = 0;
+    unsigned int rotation = 0;
+    unsigned int scaling = 0;
+};
+
+enum Method { LINEAR, BINARY, CURSOR };
+
+// Looks up the position, rotation and scaling keys of every channel at each of the given times
+static unsigned int sampleClip(const aiAnimation* anim, const std::vector<float> &times, Method method, std::vector<ChannelCursor> &cursors)
+{
+    unsigned int sum = 0;
+    for (size_t t = 0; t < times.size(); t++) {
+        const float time = times[t];
+        for (unsigned int c = 0; c < anim->mNumChannels; c++) {
+            const aiNodeAnim* channel = anim->mChannels[c];
+            ChannelCursor &cursor = cursors[c];
+            if (channel->mNumPositionKeys > 1) {
+                sum += method == LINEAR ? findKeyLinear(time, channel->mPositionKeys, channel->mNumPositionKeys)
+                     : method == BINARY ? findKey(time, channel->mPositionKeys, channel->mNumPositionKeys)
+                     : findKey(time, channel->mPositionKeys, channel->mNumPositionKeys, cursor.position);
+            }
+            if (channel->mNumRotationKeys > 1) {
+                sum += method == LINEAR ? findKeyLinear(time, channel->mRotationKeys, channel->mNumRotationKeys)
+                     : method == BINARY ? findKey(time, channel->mRotationKeys, channel->mNumRotationKeys)
+                     : findKey(time, channel->mRotationKeys, channel->mNumRotationKeys, cursor.rotation);
+            }
+            if (channel->mNumScalingKeys > 1) {
+                sum += method == LINEAR ? findKeyLinear(time, channel->mScalingKeys, channel->mNumScalingKeys)
+                     : method == BINARY ? findKey(time, channel->mScalingKeys, channel->mNumScalingKeys)
+                     : findKey(time, channel->mScalingKeys, channel->mNumScalingKeys, cursor.scaling);
+            }
+        }
+    }
+    return sum;
+}
+
+// Returns the average time in nanoseconds to sample one channel (three key lookups)
+static double timeMethod(const aiAnimation* anim, const std::vector<float> &times, Method method)
+{
+    const int repetitions = 200;
+    std::vector<ChannelCursor> cursors(anim->mNumChannels);
+    
+    // Warm up the cache and put the cursors at the start of the window
+    volatile unsigned int sink = sampleClip(anim, std::vector<float>(1, times[0]), method, cursors);
+    
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repetitions; r++) {
+        sink = sink + sampleClip(anim, times, method, cursors);
+    }
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    
+    const double samples = (double)repetitions * times.size() * anim->mNumChannels;
+    return std::chrono::duration<double, std::nano>(end - start).count() / samples;
+}
+
+int main(int argc, char** argv)
+{
+    const std::string filename = argc > 1 ? argv[1] : "boblampclean.md5mesh";
+    
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(filename, aiProcess_Triangulate);
+    if (!scene || !scene->HasAnimations()) {
+        std::printf("Could not load an animation from %s: %s\n", filename.c_str(), importer.GetErrorString());
+        return 1;
+    }
+    
+    // Benchmark the clip with the most keys
+    const aiAnimation* anim = scene->mAnimations[0];
+    unsigned int maxKeys = 0;
+    for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+        unsigned int keys = 0;
+        for (unsigned int c = 0; c < scene->mAnimations[a]->mNumChannels; c++) {
+            keys += scene->mAnimations[a]->mChannels[c]->mNumRotationKeys;
+        }
+        if (keys > maxKeys) {
+            maxKeys = keys;
+            anim = scene->mAnimations[a];
+        }
+    }
+    
+    const double ticksPerSecond = anim->mTicksPerSecond != 0 ? anim->mTicksPerSecond : 25.0;
+    std::printf("%s: clip '%s', %u channels, %u rotation keys, %.1f ticks at %.1f ticks/s\n\n", filename.c_str(), anim->mName.C_Str(), anim->mNumChannels, maxKeys, anim->mDuration, ticksPerSecond);
+    std::printf("%10s %14s %14s %14s\n", "position", "linear ns", "binary ns", "cursor ns");
+    
+    // One second of playback at 90 fps starting at each position, the way a headset would sample the clip
+    const int steps = 10;
+    for (int p = 0; p < steps; p++) {
+        const double startTick = anim->mDuration * p / steps;
+        std::vector<float> times;
+        for (int f = 0; f < 90; f++) {
+            times.push_back((float)std::fmod(startTick + f * ticksPerSecond / 90.0, anim->mDuration));
+        }
+        
+        std::printf("%9d%% %14.1f %14.1f %14.1f\n", p * 100 / steps,
+                    timeMethod(anim, times, LINEAR), timeMethod(anim, times, BINARY), timeMethod(anim, times, CURSOR));
+    }
+    
+    return 0;
+}
@@ -0,0 +1,77 @@
+//
+//  LoadBenchmark.cpp
+//
+//  Compares the time to load each model through Assimp with the time to map its cooked asset. Only the CPU side is
+//  loaded, the GL upload takes the same time on both paths. The cooked files are written next to the models.
+//
+//  Usage: load-benchmark <model files...>, for instance load-benchmark *.dae *.md5mesh in the build folder
+//
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SkinnedModelData.h"
+
+// Milliseconds to construct the CPU side of an asset from filename
+static double loadTime(const std::string &filename, int &numBones)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<SkinnedModelData> asset(new SkinnedModelData(filename, 1.0));
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    
+    numBones = asset->getNumBones();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::printf("Usage: %s <model files...>\n", argv[0]);
+        return 1;
+    }
+    
+    struct Result {
+        std::string filename;
+        double importTime;
+        double cookedTime;
+    };
+    std::vector<Result> results;
+    
+    for (int i = 1; i < argc; i++) {
+        const std::string filename = argv[i];
+        if (isCookedAsset(filename)) {
+            continue;
+        }
+        
+        const std::string cookedFilename = filename + COOKED_ASSET_EXTENSION;
+        {
+            std::unique_ptr<SkinnedModelData> asset(new SkinnedModelData(filename, 1.0));
+            if (!asset->cook(cookedFilename)) {
+                continue;
+            }
+        }
+        
+        // The first load above warmed the file cache for the import as well
+        Result result;
+        int importedBones = 0;
+        int cookedBones = 0;
+        result.filename = filename;
+        result.importTime = loadTime(filename, importedBones);
+        result.cookedTime = loadTime(cookedFilename, cookedBones);
+        if (importedBones != cookedBones) {
+            std::printf("%s: the cooked asset has %d bones instead of %d\n", filename.c_str(), cookedBones, importedBones);
+        }
+        results.push_back(result);
+    }
+    
+    // The loaders print while they work, so the table comes last
+    std::printf("\n%-40s %12s %12s %10s\n", "model", "assimp ms", "cooked ms", "speedup");
+    for (const Result &result : results) {
+        std::printf("%-40s %12.2f %12.2f %9.1fx\n", result.filename.c_str(), result.importTime, result.cookedTime, result.importTime / result.cookedTime);
+    }
+    
+    return 0;
+}
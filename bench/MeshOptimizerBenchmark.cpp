@@ -0,0 +1,90 @@
+//
+//  MeshOptimizerBenchmark.cpp
+//
+//  Imports each model with and without the mesh optimizer and reports, for every model, the vertices left after
+//  welding, the ACMR before and after reordering and the extra import time. Only the CPU side is loaded.
+//
+//  Usage: mesh-optimizer-benchmark <model files...>, for instance mesh-optimizer-benchmark *.dae *.DAE *.fbx *.obj
+//  *.md5mesh in the build folder, where the models of resources are copied
+//
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SkinnedModelData.h"
+
+// Milliseconds to import the CPU side of filename
+static double importTime(const std::string &filename, const ImportSettings &settings, std::unique_ptr<SkinnedModelData> &asset)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    asset.reset(new SkinnedModelData(filename, 1.0, settings));
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::printf("Usage: %s <model files...>\n", argv[0]);
+        return 1;
+    }
+
+    struct Result {
+        std::string filename;
+        MeshOptimizerStats total;
+        double plainTime;
+        double optimizedTime;
+    };
+    std::vector<Result> results;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string filename = argv[i];
+        if (isCookedAsset(filename)) {
+            continue;
+        }
+
+        ImportSettings plain;
+        plain.optimizeMeshes = false;
+        ImportSettings optimized;
+        optimized.optimizeMeshes = true;
+
+        std::unique_ptr<SkinnedModelData> asset;
+        Result result;
+        result.filename = filename;
+        result.plainTime = importTime(filename, plain, asset);
+        result.optimizedTime = importTime(filename, optimized, asset);
+        if (!asset->isLoaded()) {
+            continue;
+        }
+
+        // The ACMR of the model is that of all its triangles
+        for (const MeshOptimizerStats &stats : asset->getMeshOptimizerStats()) {
+            result.total.numVertices += stats.numVertices;
+            result.total.numWeldedVertices += stats.numWeldedVertices;
+            result.total.numTriangles += stats.numTriangles;
+            result.total.acmrBefore += stats.acmrBefore * stats.numTriangles;
+            result.total.acmrAfter += stats.acmrAfter * stats.numTriangles;
+        }
+        if (result.total.numTriangles > 0) {
+            result.total.acmrBefore /= result.total.numTriangles;
+            result.total.acmrAfter /= result.total.numTriangles;
+        }
+        results.push_back(result);
+    }
+
+    // The importer prints while it works, so the table comes last
+    std::printf("\nACMR with a %d vertex FIFO cache\n", ACMR_CACHE_SIZE);
+    std::printf("%-40s %10s %10s %10s %8s %8s %10s %10s\n", "model", "triangles", "vertices", "welded", "ACMR", "after",
+                "import ms", "optim ms");
+    for (const Result &result : results) {
+        std::printf("%-40s %10d %10d %10d %8.3f %8.3f %10.2f %10.2f\n", result.filename.c_str(), result.total.numTriangles,
+                    result.total.numVertices, result.total.numWeldedVertices, result.total.acmrBefore, result.total.acmrAfter,
+                    result.plainTime, result.optimizedTime - result.plainTime);
+    }
+
+    return 0;
+}
@@ -0,0 +1,13 @@
+#version 330
+
+// Glyph coverage in the red channel
+uniform sampler2D fontAtlas;
+
+in vec2 texture_coordinates;
+in vec4 text_color;
+
+out vec4 fragment_colour;
+
+void main () {
+	fragment_colour = vec4(text_color.rgb, text_color.a * texture(fontAtlas, texture_coordinates).r);
+}
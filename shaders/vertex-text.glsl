@@ -0,0 +1,17 @@
+#version 330
+
+layout (location = 0) in vec2 vertex_position;
+layout (location = 1) in vec2 vertex_texcoord;
+layout (location = 2) in vec4 vertex_color;
+
+// Pixels to clip space, with the origin at the top left of the viewport
+uniform mat4 projection_mat;
+
+out vec2 texture_coordinates;
+out vec4 text_color;
+
+void main () {
+	texture_coordinates = vertex_texcoord;
+	text_color = vertex_color;
+	gl_Position = projection_mat * vec4 (vertex_position, 0.0, 1.0);
+}
@@ -6,26 +6,169 @@ layout (location = 2) in vec2 vertex_texcoord;
 layout (location = 3) in ivec4 boneIDs[2];
 layout (location = 5) in vec4 weights[2];
 
-uniform mat4 projection_mat, view_mat, model_mat;
-uniform mat3 normal_mat;
+uniform mat4 projection_mat, view_mat;
 
 out vec3 position_world, normal_world;
 out vec2 texture_coordinates;
 
-const int MAX_BONES = 100;
-const int NUM_BONES_PER_VERTEX = 8;
-uniform mat4 bones[MAX_BONES];
+// Palettes and instance records of every instance drawn this frame, written by PaletteBuffer. A draw of several
+// instances reads one record per instance from instancesOffset: the columns of the model matrix, those of the normal
+// matrix, and the texel offsets of the instance's palette. The palette has three texels per bone matrix from
+// matricesOffset, its first three rows as Affine3x4 stores them, and the real part then the dual part of each bone,
+// (x, y, z, w), from dualQuaternionsOffset.
+// Instances whose records are not next to each other, those of one level of detail in a crowd, are drawn from a list
+// of the offsets of their records instead, four per texel from instanceListOffset, which is -1 otherwise. Every offset
+// counts from paletteOffset, where the context's copy of the frame starts.
+uniform samplerBuffer palette;
+uniform int paletteOffset;
+uniform int instancesOffset;
+uniform int instanceListOffset;
+const int INSTANCE_RECORD_TEXELS = 8;
 
-void main()
+mat4 model_mat;
+mat3 normal_mat;
+int matricesOffset;
+int dualQuaternionsOffset;
+
+void fetchInstance()
+{
+    int texel = paletteOffset + instancesOffset + INSTANCE_RECORD_TEXELS * gl_InstanceID;
+    if (instanceListOffset >= 0) {
+        ivec4 records = floatBitsToInt(texelFetch(palette, paletteOffset + instanceListOffset + gl_InstanceID / 4));
+        texel = paletteOffset + records[gl_InstanceID % 4];
+    }
+    model_mat = mat4(texelFetch(palette, texel), texelFetch(palette, texel + 1), texelFetch(palette, texel + 2), texelFetch(palette, texel + 3));
+    normal_mat = mat3(texelFetch(palette, texel + 4).xyz, texelFetch(palette, texel + 5).xyz, texelFetch(palette, texel + 6).xyz);
+    // Stored as integers, not converted to floats
+    ivec4 offsets = floatBitsToInt(texelFetch(palette, texel + 7));
+    matricesOffset = paletteOffset + offsets.x;
+    dualQuaternionsOffset = paletteOffset + offsets.y;
+}
+
+// The rows are the columns of the transpose, whose last column is the last row (0, 0, 0, 1) of every bone matrix
+mat4 boneMatrix(int bone)
+{
+    int texel = matricesOffset + 3 * bone;
+    return transpose(mat4(texelFetch(palette, texel), texelFetch(palette, texel + 1), texelFetch(palette, texel + 2), vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+vec4 dualQuaternionPart(int part)
+{
+    return texelFetch(palette, dualQuaternionsOffset + part);
+}
+
+#ifdef OPTIMIZED_CENTERS_OF_ROTATION
+// Precomputed by computeCentersOfRotation, in the space of vertex_position
+layout (location = 7) in vec3 vertex_center;
+#endif
+
+// Influences read per vertex. SkinningShaders compiles a variant for 1, 2, 4 and 8 of them, and meshes keep the
+// largest weights of each vertex first, so the variants can skip the empty slots.
+#ifndef NUM_INFLUENCES
+#define NUM_INFLUENCES 8
+#endif
+
+// Packed meshes store the normal as two snorm16 on the octahedron, in the xy of vertex_normal
+uniform int octahedralNormals;
+
+vec3 octahedralDecode(vec2 encoded)
+{
+    vec3 n = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (n.z < 0.0) {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
+
+#if defined(DUAL_QUATERNION_SKINNING) || defined(OPTIMIZED_CENTERS_OF_ROTATION)
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+// Blends the dual quaternions of the influences and normalizes the result
+void blendDualQuaternions(out vec4 real, out vec4 dual)
+{
+    real = vec4(0.0);
+    dual = vec4(0.0);
+    vec4 firstReal = dualQuaternionPart(2 * boneIDs[0][0]);
+
+    for (int i = 0; i < NUM_INFLUENCES; i++){
+        int bone = boneIDs[i / 4][i % 4];
+        vec4 boneReal = dualQuaternionPart(2 * bone);
+        // q and -q are the same rotation, blend every bone on the side of the first one
+        float weight = weights[i / 4][i % 4];
+        if (dot(boneReal, firstReal) < 0.0) {
+            weight = -weight;
+        }
+        real += boneReal * weight;
+        dual += dualQuaternionPart(2 * bone + 1) * weight;
+    }
+
+    float norm = length(real);
+    real /= norm;
+    dual /= norm;
+}
+#endif
+
+#ifndef DUAL_QUATERNION_SKINNING
+// Levels of detail draw vertices with a variant of fewer influences than they have, so the weights that are read are
+// renormalized. The blended dual quaternions are normalized anyway.
+mat4 blendMatrices()
 {
     mat4 boneTransform = mat4(0.0);
+    float weightSum = 0.0;
 
-    for (int i = 0; i < NUM_BONES_PER_VERTEX; i++){
-        boneTransform += bones[boneIDs[i / 4][i % 4]] * weights[i / 4][i % 4];
+    for (int i = 0; i < NUM_INFLUENCES; i++){
+        float weight = weights[i / 4][i % 4];
+        boneTransform += boneMatrix(boneIDs[i / 4][i % 4]) * weight;
+        weightSum += weight;
     }
+    return weightSum > 0.0 ? boneTransform / weightSum : boneTransform;
+}
+#endif
+
+#if defined(DUAL_QUATERNION_SKINNING)
+void skin(vec3 position, vec3 normal, out vec3 skinnedPosition, out vec3 skinnedNormal)
+{
+    vec4 real, dual;
+    blendDualQuaternions(real, dual);
+
+    vec3 translation = 2.0 * (real.w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz));
+    skinnedPosition = rotate(real, position) + translation;
+    skinnedNormal = rotate(real, normal);
+}
+#elif defined(OPTIMIZED_CENTERS_OF_ROTATION)
+// Rotates the vertex about its center by the blended rotation, and moves the center with linear blend skinning
+void skin(vec3 position, vec3 normal, out vec3 skinnedPosition, out vec3 skinnedNormal)
+{
+    vec4 rotation, dual;
+    blendDualQuaternions(rotation, dual);
+    vec3 center = vec3(blendMatrices() * vec4(vertex_center, 1.0));
+
+    skinnedPosition = rotate(rotation, position - vertex_center) + center;
+    skinnedNormal = rotate(rotation, normal);
+}
+#else
+void skin(vec3 position, vec3 normal, out vec3 skinnedPosition, out vec3 skinnedNormal)
+{
+    mat4 boneTransform = blendMatrices();
+
+    skinnedPosition = vec3(boneTransform * vec4(position, 1.0));
+    skinnedNormal = vec3(boneTransform * vec4(normal, 0.0));
+}
+#endif
+
+void main()
+{
+    fetchInstance();
+
+    vec3 normal = octahedralNormals != 0 ? octahedralDecode(vertex_normal.xy) : vertex_normal;
+    vec3 skinnedPosition, skinnedNormal;
+    skin(vertex_position, normal, skinnedPosition, skinnedNormal);
 
-    position_world = vec3 (model_mat * boneTransform * vec4 (vertex_position, 1.0));
-    normal_world = normalize(normal_mat * vec3(boneTransform * vec4(vertex_normal, 0.0)));
+    position_world = vec3 (model_mat * vec4 (skinnedPosition, 1.0));
+    normal_world = normalize(normal_mat * skinnedNormal);
     texture_coordinates = vertex_texcoord;
     
     gl_Position = projection_mat * view_mat * vec4 (position_world, 1.0);
@@ -4,42 +4,19 @@
 ///
 ///  Created by Trung Nguyen on 12/12/2018.
 ///
-///  \brief Model is used to load a 3d model file from disk. It will automatically create mesh objects uploaded to VBOs
+///  \brief Model is used to load a 3d model file from disk and play its first animation. It pairs an
+///         AnimatedModelAsset with a single AnimationInstance; use those directly to show a model several times.
 ///
 
 #ifndef AnimatedModel_hpp
 #define AnimatedModel_hpp
 
-#include <iostream>
-#include <iomanip>
 #include <memory>
 #include <string>
 #include <vector>
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
-#include <assimp/DefaultLogger.hpp>
-#include <assimp/LogStream.hpp>
-#include <assimp/ProgressHandler.hpp>
-#define GLM_FORCE_RADIANS
-#include <glm/glm.hpp>
-#include "BoneMesh.h"
-#include "Texture.h"
-#include "GLSLProgram.h"
+#include "AnimatedModelAsset.h"
+#include "AnimationInstance.h"
 
-
-typedef std::shared_ptr<class Importer> ImporterRef;
-
-class ProgressReporter : public Assimp::ProgressHandler
-{
-public:
-    ProgressReporter();
-    ~ProgressReporter();
-    bool Update(float percentage = -1.f);
-    void reset();
-private:
-    bool _firstUpdate;
-};
     
 class AnimatedModel : public std::enable_shared_from_this<AnimatedModel>
 {
@@ -49,80 +26,43 @@ public:
      * Tries to load a model from disk. Scale can be used to scale the vertex locations of the model. If the model contains textures than materialColor will be ignored.
      */
     AnimatedModel(const std::string &filename, const double scale, glm::vec4 materialColor = glm::vec4(1.0));
+    
+    // Plays an asset that is already loaded
+    AnimatedModel(const std::shared_ptr<AnimatedModelAsset> &asset);
 
     virtual ~AnimatedModel();
 
-    virtual void draw(basicgraphics::GLSLProgram &shader);
+    // Evaluates the first clip at timeInSecs. Call once per frame, before writePalette.
+    void update(float timeInSecs);
     
-    void setMaterialColor(const glm::vec4 &color);
+    // Writes the current palette and model matrix to frame; draw needs it to have been called at least once
+    void writePalette(PaletteFrame &frame);
     
-    void boneTransform(float timeInSecs, std::vector<glm::mat4> &transforms);
-    void printBoneName(float index);
-
-private:
-
-    glm::vec4 _materialColor;
+    // Draw from buffer, once the frame has been copied into it
+    virtual void draw(basicgraphics::GLSLProgram &shader, const PaletteBuffer &buffer);
+    virtual void draw(SkinningShaders &shaders, const PaletteBuffer &buffer);
+    // With a view, draws the level of detail the asset selects for the distance of the model to the eye. See
+    // AnimationInstance::enqueue.
+    void enqueue(RenderQueue &queue, SkinningShaders &shaders, const LodView* view = nullptr) const;
     
-    const aiScene* scene;
-
-    std::unique_ptr<Assimp::Importer> _importer;
-    std::unique_ptr<ProgressReporter> _reporter;
-    std::vector< std::shared_ptr<BoneMesh> > _meshes;
-    std::vector< std::shared_ptr<basicgraphics::Texture> > _textures;
+    void setMaterialColor(const glm::vec4 &color);
+    void setModelMatrix(const glm::mat4 &model);
     
-    std::map<std::string, int> _boneMapping = {};
+    // Linear blend skinning by default; draw(SkinningShaders&, const PaletteBuffer&) uses the matching shader variants
+    void setSkinningMode(SkinningMode mode);
     
-    #define MAX_BONES 100
+    // Samples the clips framesPerSecond times per second and plays them back from the baked palettes from now on
+    void bakeClips(float framesPerSecond);
     
-    glm::mat4 _boneOffset[MAX_BONES];
-    glm::mat4 _finalTransformation[MAX_BONES];
-
-    int _numBones = 0;
+    void boneTransform(float timeInSecs, std::vector<glm::mat4> &transforms);
+    void printBoneName(float index);
     
-    glm::mat4 _globalInverseTransform;
+    const std::shared_ptr<AnimatedModelAsset>& getAsset() const;
 
-    void importMesh(const std::string &filename, int &numIndices, const double scale);
-    void processNode(aiNode* node, const aiScene* scene, const glm::mat4 scaleMat);
-    void ReadNodeHeirarchy(float AnimationTime, aiNode* node, const aiScene *scene, const glm::mat4& ParentTransform);
-    const aiNodeAnim* FindNodeAnim(const aiAnimation* pAnimation, const string NodeName);
+private:
 
-    std::shared_ptr<BoneMesh> processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4 scaleMat);
-    
-    void CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-    void CalcInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-    void CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim);
-    uint FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim);
-    uint FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim);
-    uint FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim);
-    
-    
-    std::vector<std::shared_ptr<basicgraphics::Texture> > loadMaterialTextures(aiMaterial* mat, aiTextureType type);
+    std::shared_ptr<AnimatedModelAsset> _asset;
+    AnimationInstance _instance;
 };
 
-inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4* from)
-{
-    glm::mat4 to;
-    
-    
-    to[0][0] = (GLfloat)from->a1; to[0][1] = (GLfloat)from->b1;  to[0][2] = (GLfloat)from->c1; to[0][3] = (GLfloat)from->d1;
-    to[1][0] = (GLfloat)from->a2; to[1][1] = (GLfloat)from->b2;  to[1][2] = (GLfloat)from->c2; to[1][3] = (GLfloat)from->d2;
-    to[2][0] = (GLfloat)from->a3; to[2][1] = (GLfloat)from->b3;  to[2][2] = (GLfloat)from->c3; to[2][3] = (GLfloat)from->d3;
-    to[3][0] = (GLfloat)from->a4; to[3][1] = (GLfloat)from->b4;  to[3][2] = (GLfloat)from->c4; to[3][3] = (GLfloat)from->d4;
-    
-    return to;
-}
-
-inline glm::mat4 aiMatrix3x3ToGlm(const aiMatrix3x3* from)
-{
-    glm::mat4 to;
-    
-    
-    to[0][0] = (GLfloat)from->a1; to[0][1] = (GLfloat)from->b1;  to[0][2] = (GLfloat)from->c1; to[0][3] = 0.0f;
-    to[1][0] = (GLfloat)from->a2; to[1][1] = (GLfloat)from->b2;  to[1][2] = (GLfloat)from->c2; to[1][3] = 0.0f;
-    to[2][0] = (GLfloat)from->a3; to[2][1] = (GLfloat)from->b3;  to[2][2] = (GLfloat)from->c3; to[2][3] = 0.0f;
-    to[3][0] = 0.0f;              to[3][1] = 0.0f;               to[3][2] = 0.0f;              to[3][3] = 1.0f;
-    
-    return to;
-}
-
 #endif /* AnimatedModel_hpp */
@@ -0,0 +1,252 @@
+//
+//  AnimatedModelAsset.cpp
+//
+//  Created by Trung Nguyen on 12/12/2018.
+//
+
+#include "AnimatedModelAsset.h"
+#include "GLContext.h"
+#include "MeshBuffers.h"
+
+#include <algorithm>
+#include <iostream>
+
+
+AnimatedModelAsset::AnimatedModelAsset(const std::string &filename, const double scale, glm::vec4 materialColor, bool uploadToGPU,
+                                       const ImportSettings &settings, ProgressReporter* reporter):
+    SkinnedModelData(filename, scale, settings, reporter), _materialColor(materialColor), _meshDataReleased(false)
+{
+    if (uploadToGPU) {
+        this->uploadToGPU();
+    }
+}
+
+
+AnimatedModelAsset::~AnimatedModelAsset()
+{
+}
+
+std::shared_ptr<const AnimatedModelAsset::ContextMeshes> AnimatedModelAsset::getContextMeshes() const
+{
+    std::lock_guard<std::mutex> lock(_contextsMutex);
+    std::map<const void*, std::shared_ptr<ContextMeshes> >::const_iterator context = _contexts.find(currentGLContext());
+    return context != _contexts.end() ? context->second : nullptr;
+}
+
+void AnimatedModelAsset::draw(basicgraphics::GLSLProgram &shader) const {
+    std::shared_ptr<const ContextMeshes> context = getContextMeshes();
+    if (!context) {
+        return;
+    }
+    for (int i = 0; i < context->meshes.size(); i++) {
+        context->meshes[i]->draw(shader);
+    }
+}
+
+void AnimatedModelAsset::enqueue(RenderQueue &queue, SkinningShaders &shaders, SkinningMode mode, GLint instancesOffset, GLint instanceListOffset,
+                                 int numInstances, const glm::vec3 &position, int lod) const {
+    std::shared_ptr<const ContextMeshes> context = getContextMeshes();
+    if (!context) {
+        return;
+    }
+    for (const DrawBatch &batch : context->drawBatches[lod][mode]) {
+        RenderQueue::Item item = { &shaders, batch.mode, batch.numInfluences, instancesOffset, instanceListOffset, numInstances,
+                                   context->meshes[batch.mesh].get(), batch.firstCommand, batch.numCommands, position };
+        queue.add(item);
+    }
+}
+
+// Groups the draw ranges of every mesh by the buffers, material and shader variant they are drawn with, so that
+// each group is a single multi draw, for every level of detail
+void AnimatedModelAsset::buildDrawBatches(ContextMeshes &context)
+{
+    const std::vector< std::shared_ptr<BoneMesh> > &meshes = context.meshes;
+    for (int lod = 0; lod < NUM_LODS; lod++) {
+        for (int m = 0; m < NUM_SKINNING_MODES; m++) {
+            context.drawBatches[lod][m].clear();
+            
+            std::vector<DrawBatch> batches;
+            std::vector< std::vector<MeshBuffers::DrawCommand> > commands;
+            for (int i = 0; i < meshes.size(); i++) {
+                const BoneMesh &mesh = *meshes[i];
+                const SkinningMode meshMode = mesh.getDrawMode((SkinningMode)m);
+                for (const BoneMesh::DrawRange &range : mesh.getDrawRanges(lod)) {
+                    const int numInfluences = SkinningShaders::getVariantInfluences(SkinningShaders::getVariantIndex(range.numInfluences));
+                    
+                    int b = 0;
+                    while (b < batches.size() && !(batches[b].mode == meshMode && batches[b].numInfluences == numInfluences
+                                                  && meshes[batches[b].mesh]->getSharedBuffers() == mesh.getSharedBuffers()
+                                                  && meshes[batches[b].mesh]->hasSameMaterial(mesh))) {
+                        b++;
+                    }
+                    if (b == batches.size()) {
+                        DrawBatch batch = { i, meshMode, numInfluences, 0, 0 };
+                        batches.push_back(batch);
+                        commands.push_back(std::vector<MeshBuffers::DrawCommand>());
+                    }
+                    
+                    MeshBuffers::DrawCommand command = { (GLuint)range.numIndices, 1, (GLuint)(mesh.getFirstIndex() + range.firstIndex), mesh.getBaseVertex(), 0 };
+                    commands[b].push_back(command);
+                }
+            }
+            
+            for (int b = 0; b < batches.size(); b++) {
+                batches[b].firstCommand = meshes[batches[b].mesh]->getSharedBuffers()->addCommands(commands[b]);
+                batches[b].numCommands = (int)commands[b].size();
+            }
+            context.drawBatches[lod][m] = batches;
+        }
+    }
+}
+
+void AnimatedModelAsset::decodeTextures(JobSystem* jobs)
+{
+    std::vector<std::string> paths;
+    for (const MeshData &data : _meshData) {
+        for (const std::string &path : data.diffuseTextures) {
+            if (_decodedTextures.count(path) == 0 && std::find(paths.begin(), paths.end(), path) == paths.end()) {
+                paths.push_back(path);
+            }
+        }
+    }
+    
+    std::vector< std::shared_ptr<TextureCache::Image> > images = TextureCache::get().decode(paths, jobs);
+    for (int i = 0; i < paths.size(); i++) {
+        _decodedTextures[paths[i]] = images[i];
+    }
+}
+
+void AnimatedModelAsset::uploadToGPU(bool releaseVertices)
+{
+    if (isUploaded()) {
+        return;
+    }
+    if (_meshDataReleased) {
+        std::cout << "Cannot upload the meshes to another context, their vertices were released by the first upload" << std::endl;
+        return;
+    }
+    
+    decodeTextures();
+    std::shared_ptr<ContextMeshes> context = std::make_shared<ContextMeshes>();
+    
+    // Meshes with the same vertex format and index type share one set of buffers
+    std::vector<int> meshBuffers(_meshData.size());
+    for (int i = 0; i < _meshData.size(); i++) {
+        const GLenum indexType = MeshBuffers::getIndexType(_meshData[i].numVertices);
+        int b = 0;
+        while (b < i && !(_meshData[meshBuffers[b]].vertexFormat == _meshData[i].vertexFormat &&
+                          MeshBuffers::getIndexType(_meshData[meshBuffers[b]].numVertices) == indexType)) {
+            b++;
+        }
+        meshBuffers[i] = b < i ? meshBuffers[b] : i;
+    }
+    
+    std::vector< std::shared_ptr<MeshBuffers> > buffers(_meshData.size());
+    for (int i = 0; i < _meshData.size(); i++) {
+        if (meshBuffers[i] != i) {
+            continue;
+        }
+        int numVertices = 0;
+        int numIndices = 0;
+        bool centersOfRotation = false;
+        for (int j = i; j < _meshData.size(); j++) {
+            if (meshBuffers[j] == i) {
+                numVertices += _meshData[j].numVertices;
+                numIndices += _meshData[j].numIndices;
+                for (const MeshData::Lod &level : _meshData[j].lods) {
+                    numIndices += level.numIndices;
+                }
+                centersOfRotation = centersOfRotation || !_meshData[j].centersOfRotation.empty();
+            }
+        }
+        buffers[i].reset(new MeshBuffers(_meshData[i].vertexFormat, MeshBuffers::getIndexType(_meshData[i].numVertices), GL_STATIC_DRAW,
+                                         numVertices, numIndices, centersOfRotation));
+    }
+    
+    for (int i = 0; i < _meshData.size(); i++) {
+        const MeshData &data = _meshData[i];
+        
+        std::vector<std::shared_ptr<basicgraphics::Texture> > textures = this->loadMaterialTextures(data.diffuseTextures);
+        
+        const std::shared_ptr<MeshBuffers> &meshBuffer = buffers[meshBuffers[i]];
+        const bool centersOfRotation = !data.centersOfRotation.empty();
+        const MeshBuffers::Allocation allocation = meshBuffer->add(data.vertices, data.numVertices, data.indices, data.numIndices,
+                                                                   centersOfRotation ? &data.centersOfRotation[0] : nullptr);
+        
+        std::shared_ptr<BoneMesh> gpuMesh(new BoneMesh(textures, GL_TRIANGLES, meshBuffer, allocation.baseVertex, allocation.firstIndex, data.numVertices, data.numIndices, centersOfRotation));
+        
+        gpuMesh->setDrawRanges(data.drawRanges);
+        gpuMesh->setMaterialColor(_materialColor);
+        context->meshes.push_back(gpuMesh);
+    }
+    
+    // Levels of detail go after the meshes, so that the indices of every mesh stay contiguous
+    for (int i = 0; i < _meshData.size(); i++) {
+        const MeshData &data = _meshData[i];
+        const std::shared_ptr<MeshBuffers> &meshBuffer = buffers[meshBuffers[i]];
+        std::vector< std::vector<BoneMesh::DrawRange> > lodRanges;
+        for (const MeshData::Lod &level : data.lods) {
+            const int firstIndex = meshBuffer->addIndices(level.indices, level.numIndices) - context->meshes[i]->getFirstIndex();
+            lodRanges.push_back(level.drawRanges);
+            for (BoneMesh::DrawRange &range : lodRanges.back()) {
+                range.firstIndex += firstIndex;
+            }
+        }
+        context->meshes[i]->setLodDrawRanges(lodRanges);
+    }
+    
+    // The VBOs hold the vertices from now on
+    if (releaseVertices) {
+        releaseMeshData();
+        _decodedTextures.clear();
+        _meshDataReleased = true;
+    }
+    
+    buildDrawBatches(*context);
+    
+    std::lock_guard<std::mutex> lock(_contextsMutex);
+    _contexts[currentGLContext()] = context;
+}
+
+bool AnimatedModelAsset::isUploaded() const
+{
+    return getContextMeshes() != nullptr;
+}
+
+void AnimatedModelAsset::releaseFromGPU()
+{
+    std::lock_guard<std::mutex> lock(_contextsMutex);
+    _contexts.erase(currentGLContext());
+}
+
+bool AnimatedModelAsset::isUploadedAnywhere() const
+{
+    std::lock_guard<std::mutex> lock(_contextsMutex);
+    return !_contexts.empty();
+}
+
+// Uploads the textures decoded for the given paths. The cache shares those that were uploaded before, by this model
+// or any other.
+std::vector<std::shared_ptr<basicgraphics::Texture> > AnimatedModelAsset::loadMaterialTextures(const std::vector<std::string> &paths)
+{
+    std::vector<std::shared_ptr<basicgraphics::Texture> > textures;
+    for (const std::string &path : paths) {
+        std::shared_ptr<basicgraphics::Texture> texture = TextureCache::get().upload(*_decodedTextures[path]);
+        if (texture) {
+            textures.push_back(texture);
+        }
+    }
+    return textures;
+}
+
+
+//Set color of model based on given color
+void AnimatedModelAsset::setMaterialColor(const glm::vec4 &color){
+    _materialColor = color;
+    std::lock_guard<std::mutex> lock(_contextsMutex);
+    for (const std::pair<const void* const, std::shared_ptr<ContextMeshes> > &context : _contexts) {
+        for(int i=0; i < context.second->meshes.size(); i++){
+            context.second->meshes[i]->setMaterialColor(color);
+        }
+    }
+}
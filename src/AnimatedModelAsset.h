@@ -0,0 +1,102 @@
+///
+///  AnimatedModelAsset.h
+///
+///  Created by Trung Nguyen on 12/12/2018.
+///
+///  \brief Everything loaded from a model file that does not change while it plays: the meshes uploaded to VBOs,
+///         textures, skeleton, bone offsets and animation clips. One asset is shared by every AnimationInstance
+///         showing the model, so a crowd only imports and uploads it once per GL context. The CPU side is
+///         SkinnedModelData.
+///
+
+#ifndef AnimatedModelAsset_hpp
+#define AnimatedModelAsset_hpp
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "SkinnedModelData.h"
+#include "BoneMesh.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
+#include "Texture.h"
+#include "GLSLProgram.h"
+
+
+class AnimatedModelAsset : public SkinnedModelData
+{
+public:
+    
+    /*!
+     * Tries to load a model from disk. Scale can be used to scale the vertex locations of the model. If the model contains textures than materialColor will be ignored.
+     * Without uploadToGPU only the CPU side (skeleton, clips, vertices) is loaded and no GL context is needed.
+     * settings control how vertices and animation keys are stored.
+     * Files ending in COOKED_ASSET_EXTENSION are mapped instead of imported; scale and settings were applied when
+     * they were cooked. reporter, if any, receives the progress of the import and must outlive the constructor.
+     */
+    AnimatedModelAsset(const std::string &filename, const double scale, glm::vec4 materialColor = glm::vec4(1.0), bool uploadToGPU = true,
+                       const ImportSettings &settings = ImportSettings(), ProgressReporter* reporter = nullptr);
+    
+    virtual ~AnimatedModelAsset();
+    
+    // Reads and decodes the texture files of the meshes, in parallel on jobs if given, so that uploadToGPU only has to
+    // upload them. Can run on any thread. Textures that another model already uploaded are not read again.
+    void decodeTextures(JobSystem* jobs = nullptr);
+    
+    // Creates the VBOs and textures of the meshes in the current GL context, decoding the textures first if
+    // decodeTextures was not called. Each context drawing the asset uploads it once. The vertices are released
+    // afterwards, unless releaseVertices is false to leave them for the uploads of other contexts.
+    void uploadToGPU(bool releaseVertices = true);
+    // True once uploaded to the current context
+    bool isUploaded() const;
+    // Deletes the meshes of the current context. Once every context that uploaded the asset released it, it can be
+    // destroyed without a context current.
+    void releaseFromGPU();
+    // True while any context has the meshes
+    bool isUploadedAnywhere() const;
+    
+    // Draws every mesh deformed by the palette that AnimationInstance::draw binds, with the current context's meshes
+    void draw(basicgraphics::GLSLProgram &shader) const;
+    // Adds the draw ranges of every mesh at level of detail lod to queue, drawn with the variant of shaders for their
+    // influence count and mode. Ranges that share a material and variant are one item. Items draw numInstances
+    // instances whose records start at instancesOffset, or are listed at instanceListOffset unless it is -1, and are
+    // placed at position when sorted. Nothing is added before the upload to the current context.
+    void enqueue(RenderQueue &queue, SkinningShaders &shaders, SkinningMode mode, GLint instancesOffset, GLint instanceListOffset,
+                 int numInstances, const glm::vec3 &position, int lod = 0) const;
+    
+    void setMaterialColor(const glm::vec4 &color);
+
+private:
+    
+    glm::vec4 _materialColor;
+    
+    // Draw ranges of meshes that share buffers, material and shader variant, drawn by one multi draw of the
+    // buffers' commands with the material of _meshes[mesh]
+    struct DrawBatch {
+        int mesh;
+        SkinningMode mode;
+        int numInfluences;
+        int firstCommand;
+        int numCommands;
+    };
+    
+    // What a context uploaded. VAOs are never shared between contexts, so each one draws its own meshes.
+    struct ContextMeshes {
+        std::vector< std::shared_ptr<BoneMesh> > meshes;
+        std::vector<DrawBatch> drawBatches[NUM_LODS][NUM_SKINNING_MODES];
+    };
+    mutable std::mutex _contextsMutex;
+    std::map<const void*, std::shared_ptr<ContextMeshes> > _contexts;      // by currentGLContext()
+    bool _meshDataReleased;
+    std::map<std::string, std::shared_ptr<TextureCache::Image> > _decodedTextures;  // until the vertices are released
+    
+    // Of the current context, null before its upload
+    std::shared_ptr<const ContextMeshes> getContextMeshes() const;
+    static void buildDrawBatches(ContextMeshes &context);
+    
+    std::vector<std::shared_ptr<basicgraphics::Texture> > loadMaterialTextures(const std::vector<std::string> &paths);
+};
+
+#endif /* AnimatedModelAsset_hpp */
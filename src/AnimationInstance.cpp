@@ -0,0 +1,301 @@
+//
+//  AnimationInstance.cpp
+//
+
+#include "AnimationInstance.h"
+#include "PaletteCache.h"
+
+#include "glm/ext.hpp"
+
+
+AnimationInstance::AnimationInstance(const std::shared_ptr<const AnimatedModelAsset> &asset) :
+    _asset(asset), _clip(0), _time(0.0f), _skinningMode(LINEAR_BLEND_SKINNING), _pose(*asset),
+    _modelMatrix(1.0), _writtenMode(LINEAR_BLEND_SKINNING)
+{
+    _palette.assign(_asset->getNumBones(), toAffine(glm::mat4(1.0)));
+}
+
+const std::shared_ptr<const AnimatedModelAsset>& AnimationInstance::getAsset() const
+{
+    return _asset;
+}
+
+void AnimationInstance::setClip(int clip)
+{
+    assert(clip >= 0 && clip < _asset->getNumClips());
+    _clip = clip;
+}
+
+int AnimationInstance::getClip() const
+{
+    return _clip;
+}
+
+void AnimationInstance::setPaletteCache(const std::shared_ptr<const PaletteCache> &cache)
+{
+    _paletteCache = cache;
+}
+
+void AnimationInstance::update(float timeInSecs)
+{
+    _time = timeInSecs;
+    
+    // Models without animations stay in their bind pose
+    if (_clip >= _asset->getNumClips()) {
+        return;
+    }
+    
+    if (_paletteCache) {
+        _paletteCache->sample(_clip, timeInSecs, _palette);
+    }
+    else {
+        _pose.evaluate(_clip, timeInSecs, _palette);
+    }
+    
+    if (_skinningMode != LINEAR_BLEND_SKINNING) {
+        updateDualQuaternions();
+    }
+}
+
+float AnimationInstance::getTime() const
+{
+    return _time;
+}
+
+const std::vector<Affine3x4>& AnimationInstance::getPalette() const
+{
+    return _palette;
+}
+
+void AnimationInstance::setSkinningMode(SkinningMode mode)
+{
+    _skinningMode = mode;
+    if (_skinningMode != LINEAR_BLEND_SKINNING) {
+        updateDualQuaternions();
+    }
+}
+
+SkinningMode AnimationInstance::getSkinningMode() const
+{
+    return _skinningMode;
+}
+
+const std::vector<DualQuaternion>& AnimationInstance::getDualQuaternions() const
+{
+    return _dualQuaternions;
+}
+
+void AnimationInstance::updateDualQuaternions()
+{
+    _dualQuaternions.resize(_palette.size());
+    for (int i = 0; i < _palette.size(); i++) {
+        _dualQuaternions[i] = toDualQuaternion(_palette[i]);
+    }
+}
+
+void AnimationInstance::setModelMatrix(const glm::mat4 &model)
+{
+    _modelMatrix = model;
+}
+
+const glm::mat4& AnimationInstance::getModelMatrix() const
+{
+    return _modelMatrix;
+}
+
+// What the vertex shader fetches for each instance, INSTANCE_RECORD_TEXELS in vertex.glsl
+struct InstanceRecord {
+    glm::mat4 model;
+    glm::vec4 normal[3];        // columns of the normal matrix
+    GLint matricesOffset;       // texels
+    GLint dualQuaternionsOffset;
+    GLint padding[2];
+};
+static_assert(sizeof(InstanceRecord) == 8 * PaletteBuffer::TEXEL_SIZE, "vertex.glsl reads 8 texels per instance");
+static const GLint INSTANCE_RECORD_TEXELS = (GLint)(sizeof(InstanceRecord) / PaletteBuffer::TEXEL_SIZE);
+
+static InstanceRecord makeInstanceRecord(const glm::mat4 &model, const PaletteBuffer::Range &matrices, const PaletteBuffer::Range &dualQuaternions)
+{
+    InstanceRecord record;
+    record.model = model;
+    const glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+    for (int c = 0; c < 3; c++) {
+        record.normal[c] = glm::vec4(normal[c], 0.0f);
+    }
+    record.matricesOffset = matrices.offset;
+    record.dualQuaternionsOffset = dualQuaternions.offset;
+    record.padding[0] = record.padding[1] = 0;
+    return record;
+}
+
+void AnimationInstance::writePalette(PaletteFrame &frame)
+{
+    writePalettes(std::vector<AnimationInstance*>(1, this), frame);
+}
+
+void AnimationInstance::writePalettes(const std::vector<AnimationInstance*> &instances, PaletteFrame &frame)
+{
+    std::vector<InstanceRecord> records;
+    records.reserve(instances.size());
+    for (AnimationInstance* instance : instances) {
+        instance->_writtenMode = instance->_skinningMode;
+        instance->_matricesRange = PaletteBuffer::Range();
+        instance->_dualQuaternionsRange = PaletteBuffer::Range();
+        instance->_instanceRange = PaletteBuffer::Range();
+        if (!instance->_palette.empty()) {
+            if (instance->_skinningMode != DUAL_QUATERNION_SKINNING) {
+                // The last row of every bone is (0, 0, 0, 1), so only the first three are written, one texel each
+                instance->_matricesRange = frame.write(&instance->_palette[0], instance->_palette.size() * sizeof(Affine3x4));
+            }
+            if (instance->_skinningMode != LINEAR_BLEND_SKINNING) {
+                instance->_dualQuaternionsRange = frame.write(&instance->_dualQuaternions[0],
+                                                              instance->_dualQuaternions.size() * sizeof(DualQuaternion));
+            }
+        }
+        records.push_back(makeInstanceRecord(instance->_modelMatrix, instance->_matricesRange, instance->_dualQuaternionsRange));
+    }
+    if (records.empty()) {
+        return;
+    }
+    
+    const PaletteBuffer::Range range = frame.write(&records[0], records.size() * sizeof(InstanceRecord));
+    if (range.size == 0) {
+        return;
+    }
+    for (size_t i = 0; i < instances.size(); i++) {
+        instances[i]->_instanceRange.offset = range.offset + (GLint)i * INSTANCE_RECORD_TEXELS;
+        instances[i]->_instanceRange.size = INSTANCE_RECORD_TEXELS;
+    }
+}
+
+// True if the last write fit, with the palette the skinning mode reads
+bool AnimationInstance::isWritten() const
+{
+    if (_instanceRange.size == 0) {
+        return false;
+    }
+    if (!_palette.empty()) {
+        if (_writtenMode != DUAL_QUATERNION_SKINNING && _matricesRange.size == 0) {
+            return false;
+        }
+        if (_writtenMode != LINEAR_BLEND_SKINNING && _dualQuaternionsRange.size == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void AnimationInstance::bindPalette(const PaletteBuffer &buffer, SkinningShaders &shaders)
+{
+    buffer.bind();
+    shaders.setPaletteOffset(buffer.getFrameOffset());
+}
+
+void AnimationInstance::draw(basicgraphics::GLSLProgram &shader, const PaletteBuffer &buffer) const
+{
+    if (isWritten()) {
+        buffer.bind();
+        shader.use();
+        shader.setUniform("paletteOffset", buffer.getFrameOffset());
+        shader.setUniform("instancesOffset", _instanceRange.offset);
+        shader.setUniform("instanceListOffset", -1);
+        // shader may be a variant of SkinningShaders, which would otherwise assume it still has its last values
+        SkinningShaders::invalidateUniforms();
+        _asset->draw(shader);
+    }
+}
+
+void AnimationInstance::draw(SkinningShaders &shaders, const PaletteBuffer &buffer) const
+{
+    bindPalette(buffer, shaders);
+    RenderQueue queue;
+    enqueue(queue, shaders);
+    queue.flush(glm::mat4(1.0));
+}
+
+void AnimationInstance::enqueue(RenderQueue &queue, SkinningShaders &shaders, const LodView* view) const
+{
+    if (isWritten()) {
+        _asset->enqueue(queue, shaders, _writtenMode, _instanceRange.offset, -1, 1, glm::vec3(_modelMatrix[3]), selectLod(view));
+    }
+}
+
+// The model matrix is assumed to scale uniformly
+int AnimationInstance::selectLod(const LodView* view) const
+{
+    if (view == nullptr) {
+        return 0;
+    }
+    return _asset->selectLod(*view, glm::vec3(_modelMatrix[3]), glm::length(glm::vec3(_modelMatrix[0])));
+}
+
+void AnimationInstance::drawInstanced(const std::vector<const AnimationInstance*> &instances, PaletteBuffer &buffer, SkinningShaders &shaders)
+{
+    bindPalette(buffer, shaders);
+    RenderQueue queue;
+    enqueueInstanced(instances, buffer, queue, shaders);
+    queue.flush(glm::mat4(1.0));
+}
+
+void AnimationInstance::enqueueInstanced(const std::vector<const AnimationInstance*> &instances, PaletteBuffer &buffer, RenderQueue &queue,
+                                         SkinningShaders &shaders, const LodView* view)
+{
+    if (instances.empty()) {
+        return;
+    }
+    const AnimatedModelAsset &asset = *instances[0]->_asset;
+    const SkinningMode mode = instances[0]->_writtenMode;
+    
+    // The records were written once this frame, only the instances of each level of detail change with the view
+    std::vector<GLint> records[NUM_LODS];
+    glm::vec3 centers[NUM_LODS];
+    std::fill(centers, centers + NUM_LODS, glm::vec3(0.0f));
+    for (const AnimationInstance* instance : instances) {
+        assert(instance->_asset.get() == &asset && instance->_writtenMode == mode);
+        if (instance->isWritten()) {
+            const int lod = instance->selectLod(view);
+            records[lod].push_back(instance->_instanceRange.offset);
+            centers[lod] += glm::vec3(instance->_modelMatrix[3]);
+        }
+    }
+    
+    const size_t offsetsPerTexel = PaletteBuffer::TEXEL_SIZE / sizeof(GLint);
+    for (int lod = 0; lod < NUM_LODS; lod++) {
+        const int numInstances = (int)records[lod].size();
+        if (numInstances == 0) {
+            continue;
+        }
+        const glm::vec3 center = centers[lod] / (float)numInstances;
+        
+        // Usually every instance, or a run of them, is at the same level of detail and drawn straight from the records
+        bool consecutive = true;
+        for (int i = 1; i < numInstances && consecutive; i++) {
+            consecutive = records[lod][i] == records[lod][0] + i * INSTANCE_RECORD_TEXELS;
+        }
+        if (consecutive) {
+            asset.enqueue(queue, shaders, mode, records[lod][0], -1, numInstances, center, lod);
+            continue;
+        }
+        
+        records[lod].resize((numInstances + offsetsPerTexel - 1) / offsetsPerTexel * offsetsPerTexel, 0);
+        const PaletteBuffer::Range list = buffer.write(&records[lod][0], records[lod].size() * sizeof(GLint));
+        if (list.size != 0) {
+            asset.enqueue(queue, shaders, mode, 0, list.offset - buffer.getFrameOffset(), numInstances, center, lod);
+        }
+    }
+}
+
+void AnimationInstance::updateAll(const std::vector<AnimationInstance*> &instances, const std::vector<float> &times, JobSystem &jobs)
+{
+    assert(instances.size() == times.size());
+    
+    // A few ranges per thread leaves room for stealing when some instances have more bones than others
+    const int count = (int)instances.size();
+    const int grainSize = std::max(1, count / (jobs.getNumThreads() * 8));
+    
+    jobs.parallelFor(count, grainSize, [&instances, &times](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            instances[i]->update(times[i]);
+        }
+    });
+}
@@ -0,0 +1,110 @@
+///
+///  AnimationInstance.h
+///
+///  \brief One character playing an AnimatedModelAsset: the clip it plays, its playback time and its bone palette.
+///         Instances are small and only reference the shared asset, so hundreds of them can show the same model.
+///
+
+#ifndef AnimationInstance_hpp
+#define AnimationInstance_hpp
+
+#include <memory>
+#include <vector>
+#include "AnimatedModelAsset.h"
+#include "JobSystem.h"
+#include "PaletteBuffer.h"
+#include "PoseEvaluator.h"
+
+class PaletteCache;
+
+class AnimationInstance
+{
+public:
+    
+    AnimationInstance(const std::shared_ptr<const AnimatedModelAsset> &asset);
+    
+    const std::shared_ptr<const AnimatedModelAsset>& getAsset() const;
+    
+    // Selects one of the asset's clips, the first one by default
+    void setClip(int clip);
+    int getClip() const;
+    
+    // Plays clips from baked palettes instead of evaluating them, or evaluates them again when cache is null
+    void setPaletteCache(const std::shared_ptr<const PaletteCache> &cache);
+    
+    // Evaluates the current clip at timeInSecs (wrapped to the clip length) and updates the palette
+    void update(float timeInSecs);
+    float getTime() const;
+    
+    // One transform per bone of the asset, the identity until the first update
+    const std::vector<Affine3x4>& getPalette() const;
+    
+    // Dual quaternion skinning and optimized centers of rotation also convert the palette to getDualQuaternions() at
+    // every update, and draw with them
+    void setSkinningMode(SkinningMode mode);
+    SkinningMode getSkinningMode() const;
+    const std::vector<DualQuaternion>& getDualQuaternions() const;
+    
+    // Placement of the instance in the world, the identity by default
+    void setModelMatrix(const glm::mat4 &model);
+    const glm::mat4& getModelMatrix() const;
+    
+    // Writes the palette, in the forms the skinning mode reads, and the instance record pointing at it to frame.
+    // Every instance is written once per frame, however many meshes, variants, views and contexts draw it.
+    void writePalette(PaletteFrame &frame);
+    // Same for instances that are drawn together. Their records are written after every palette, next to each other
+    // in the order of instances, so that the shaders find every instance's model matrix and palette from gl_InstanceID.
+    static void writePalettes(const std::vector<AnimationInstance*> &instances, PaletteFrame &frame);
+    
+    // Binds buffer, which holds a copy of the frame the palettes were written to, for the draws of shaders
+    static void bindPalette(const PaletteBuffer &buffer, SkinningShaders &shaders);
+    
+    // Draw with the palette last written, from the copy of its frame in buffer. Nothing is drawn before the first
+    // write, or if the palette did not fit.
+    void draw(basicgraphics::GLSLProgram &shader, const PaletteBuffer &buffer) const;
+    void draw(SkinningShaders &shaders, const PaletteBuffer &buffer) const;
+    // Same, adding the draws to queue to be sorted with those of other models, once bindPalette has been called. With
+    // a view, the instance is drawn at the level of detail the asset selects for its distance to the eye.
+    void enqueue(RenderQueue &queue, SkinningShaders &shaders, const LodView* view = nullptr) const;
+    
+    // Draws instances, which share an asset and skinning mode and were written by one writePalettes this frame, with
+    // one instanced draw per batch of the asset
+    static void drawInstanced(const std::vector<const AnimationInstance*> &instances, PaletteBuffer &buffer, SkinningShaders &shaders);
+    // Same, adding the draws to queue once bindPalette has been called. Translucent draws are sorted by the center of
+    // the instances. With a view, the instances are grouped by level of detail; a group whose records are not next to
+    // each other is drawn from a list of the offsets of its records, written to buffer for this view.
+    static void enqueueInstanced(const std::vector<const AnimationInstance*> &instances, PaletteBuffer &buffer, RenderQueue &queue,
+                                 SkinningShaders &shaders, const LodView* view = nullptr);
+    
+    // Updates instances[i] at times[i] on all threads of jobs and returns once every palette is ready.
+    // Each instance only writes to itself, so the palettes do not depend on the number of threads.
+    static void updateAll(const std::vector<AnimationInstance*> &instances, const std::vector<float> &times, JobSystem &jobs);
+    
+private:
+    
+    std::shared_ptr<const AnimatedModelAsset> _asset;
+    int _clip;
+    float _time;
+    std::shared_ptr<const PaletteCache> _paletteCache;
+    SkinningMode _skinningMode;
+    
+    PoseEvaluator _pose;
+    std::vector<Affine3x4> _palette;
+    std::vector<DualQuaternion> _dualQuaternions;   // one per bone, not kept up to date for linear blend skinning
+    
+    glm::mat4 _modelMatrix;
+    
+    // Where writePalettes put the palette and the instance record in the frame, and the skinning mode they were
+    // written for
+    SkinningMode _writtenMode;
+    PaletteBuffer::Range _matricesRange;
+    PaletteBuffer::Range _dualQuaternionsRange;
+    PaletteBuffer::Range _instanceRange;
+    
+    void updateDualQuaternions();
+    int selectLod(const LodView* view) const;
+    // False before the first writePalettes
+    bool isWritten() const;
+};
+
+#endif /* AnimationInstance_hpp */
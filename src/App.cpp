@@ -3,6 +3,7 @@
 //
 
 #include "App.hpp"
+#include "GLContext.h"
 
 #define FONTSTASH_IMPLEMENTATION
 #include <fontstash.h>
@@ -12,13 +13,23 @@
 #include <config/VRDataIndex.h>
 #include <main/VRSystem.h>
 
+#include <algorithm>
 #include <iostream>
 using namespace std;
 using namespace glm;
 
+// Room for the palettes of a few hundred instances every frame
+static const size_t PALETTE_FRAME_BYTES = 1 << 21;
+// and in every context, for the lists of the instances each view draws at a level of detail
+static const size_t INSTANCE_LIST_BYTES = 1 << 16;
 
-App::App(int argc, char** argv) : VRApp(argc, argv) {
+
+App::App(int argc, char** argv) : VRApp(argc, argv), _frame(0), _paletteFrame(PALETTE_FRAME_BYTES), _skinningMode(LINEAR_BLEND_SKINNING), _useLods(true),
+    _showOverlay(false) {
     _startTime = VRSystem::getTime();
+    
+    //import a new model to use in the program, on the loader thread
+    loadModel(false);
 }
 
 App::~App()
@@ -26,6 +37,15 @@ App::~App()
     shutdown();
 }
 
+void App::loadModel(bool centersOfRotation)
+{
+    ImportSettings settings;
+    settings.packVertices = true;
+    settings.centersOfRotation = centersOfRotation;
+    _modelLoad = _loader.load("boblampclean.md5mesh", 1.0, vec4(1.0), settings);
+    _modelCenters = centersOfRotation;
+}
+
 void App::onAnalogChange(const VRAnalogEvent &event) {
 }
 
@@ -33,6 +53,52 @@ void App::onAnalogChange(const VRAnalogEvent &event) {
 void App::onButtonDown(const VRButtonEvent &event) {
     // This routine is called for all Button_Down events.  Check event->getName()
     // to see exactly which button has been pressed down.
+    if (event.getName() == "KbdD_Down") {
+        static const char* names[NUM_SKINNING_MODES] = { "Linear blend skinning", "Dual quaternion skinning", "Optimized centers of rotation" };
+        _skinningMode = (SkinningMode)((_skinningMode + 1) % NUM_SKINNING_MODES);
+        std::cout << names[_skinningMode] << std::endl;
+        if (_modelMesh) {
+            _modelMesh->setSkinningMode(_skinningMode);
+        }
+        for (std::unique_ptr<AnimationInstance> &instance : _crowd) {
+            instance->setSkinningMode(_skinningMode);
+        }
+    }
+    else if (event.getName() == "KbdC_Down") {
+        if (!_crowd.empty()) {
+            _crowd.clear();
+        }
+        else if (_modelMesh) {
+            // A square of characters behind the first one, all drawn by the same instanced draws
+            const int side = 16;
+            for (int i = 0; i < side * side; i++) {
+                std::unique_ptr<AnimationInstance> instance(new AnimationInstance(_modelMesh->getAsset()));
+                instance->setModelMatrix(glm::translate(glm::mat4(1.0), glm::vec3((i % side - side / 2) * 40.0f, (i / side) * 40.0f, 0.0f)));
+                instance->setSkinningMode(_skinningMode);
+                _crowd.push_back(std::move(instance));
+            }
+            std::cout << "Crowd of " << _crowd.size() << " instances" << std::endl;
+        }
+    }
+    else if (event.getName() == "KbdL_Down") {
+        _useLods = !_useLods;
+        std::cout << "Levels of detail " << (_useLods ? "on" : "off") << std::endl;
+    }
+    else if (event.getName() == "KbdT_Down") {
+        _showOverlay = !_showOverlay;
+    }
+    else if (event.getName() == "KbdR_Down" || event.getName() == "KbdJ_Down") {
+        if (_profiler.isTracing()) {
+            _profiler.stopTrace();
+            std::cout << "Stopped recording the frame trace" << std::endl;
+        }
+        else {
+            const std::string filename = event.getName() == "KbdR_Down" ? "frame-trace.csv" : "frame-trace.json";
+            if (_profiler.startTrace(filename)) {
+                std::cout << "Recording the frame trace to " << filename << std::endl;
+            }
+        }
+    }
 }
 
 void App::onButtonUp(const VRButtonEvent &event) {
@@ -45,6 +111,23 @@ void App::onCursorMove(const VRCursorEvent &event){
     // or the relative position within the window scaled 0--1.
 }
 
+void App::onGenericEvent(const VRDataIndex &event){
+    // MinVR sends FrameStart once per frame, before it renders on any display
+    if (event.getName() == "FrameStart") {
+        _frame++;
+        updateFrame(_frame);
+    }
+}
+
+App::ContextResources& App::getContextResources(){
+    std::lock_guard<std::mutex> lock(_contextsMutex);
+    std::unique_ptr<ContextResources> &resources = _contexts[currentGLContext()];
+    if (!resources) {
+        resources.reset(new ContextResources());
+    }
+    return *resources;
+}
+
 void App::onRenderGraphicsContext(const VRGraphicsState &renderState){
     // This routine is called once per graphics context at the start of the
     // rendering process.  So, this is the place to initialize textures,
@@ -79,8 +162,106 @@ void App::onRenderGraphicsContext(const VRGraphicsState &renderState){
         // This load shaders from disk, we do it once when the program starts up.
         reloadShaders();
         
-        //import a new model to use in the program
-        _modelMesh.reset(new AnimatedModel("boblampclean.md5mesh", 1.0, vec4(1.0)));
+        ContextResources &resources = getContextResources();
+        resources.paletteBuffer.reset(new PaletteBuffer(PALETTE_FRAME_BYTES + INSTANCE_LIST_BYTES));
+        
+        // The font comes with the BasicGraphics resources
+        resources.overlay.reset(new ProfilerOverlay("DroidSansMono.ttf", "vertex-text.glsl", "fragment-text.glsl"));
+    }
+    
+    ContextResources &resources = getContextResources();
+    _profiler.readGpuTimers();
+    
+    // The model is drawn by every context from its own buffers, uploaded the first time the context sees it
+    if (_modelMesh && !_modelMesh->getAsset()->isUploaded()) {
+        FrameProfiler::CpuScope scope(_profiler, "asset upload");
+        _modelMesh->getAsset()->uploadToGPU(false);
+    }
+    
+    // and deleted by each context once replaced
+    {
+        std::lock_guard<std::mutex> lock(_retiredMutex);
+        for (const std::shared_ptr<AnimatedModelAsset> &asset : _retiredAssets) {
+            asset->releaseFromGPU();
+        }
+        _retiredAssets.erase(std::remove_if(_retiredAssets.begin(), _retiredAssets.end(),
+                                            [](const std::shared_ptr<AnimatedModelAsset> &asset) { return !asset->isUploadedAnywhere(); }),
+                             _retiredAssets.end());
+    }
+    
+    // Copy the palettes of this frame into the buffer of this context, once however many eyes draw them
+    if (resources.uploadedFrame != _frame) {
+        FrameProfiler::CpuScope scope(_profiler, "palette upload");
+        resources.paletteBuffer->beginFrame();
+        resources.hasPalettes = resources.paletteBuffer->upload(_paletteFrame);
+        resources.uploadedFrame = _frame;
+    }
+}
+
+void App::updateFrame(int frame){
+    // Runs once per frame on the CPU, however many contexts and eyes draw it
+    _profiler.beginFrame(frame);
+    
+    // Swap in the model once the loader has imported it
+    if (_modelLoad.isValid() && _modelLoad.getStage() >= AssetLoader::READY) {
+        // The import ran on the loader thread, it shows up in the frame the model does
+        _profiler.addCpuTime("import", _modelLoad.getImportTime());
+        std::shared_ptr<AnimatedModelAsset> asset = _modelLoad.get();
+        if (asset) {
+            if (_modelMesh) {
+                std::lock_guard<std::mutex> lock(_retiredMutex);
+                _retiredAssets.push_back(_modelMesh->getAsset());
+            }
+            _modelMesh.reset(new AnimatedModel(asset));
+            _modelMesh->setSkinningMode(_skinningMode);
+            for (std::unique_ptr<AnimationInstance> &instance : _crowd) {
+                std::unique_ptr<AnimationInstance> replacement(new AnimationInstance(asset));
+                replacement->setModelMatrix(instance->getModelMatrix());
+                replacement->setSkinningMode(_skinningMode);
+                instance = std::move(replacement);
+            }
+        }
+        _modelLoad = AssetLoader::Handle();
+    }
+    // The first time optimized centers of rotation are selected, the model is imported again with its centers. Until
+    // it replaces the first one, meshes without centers draw with linear blend skinning.
+    if (_skinningMode == OPTIMIZED_CENTERS_OF_ROTATION && !_modelCenters && !_modelLoad.isValid()) {
+        loadModel(true);
+    }
+    
+    // Every pose is evaluated once per frame, the crowd on all cores. Instances start a little apart in their clip so
+    // that they do not move in step.
+    {
+        FrameProfiler::CpuScope scope(_profiler, "pose");
+        const float time = (float)(VRSystem::getTime() - _startTime);
+        if (_modelMesh) {
+            _modelMesh->update(time);
+        }
+        if (!_crowd.empty()) {
+            std::vector<AnimationInstance*> instances;
+            std::vector<float> times;
+            for (size_t i = 0; i < _crowd.size(); i++) {
+                instances.push_back(_crowd[i].get());
+                times.push_back(time + 0.1f * i);
+            }
+            AnimationInstance::updateAll(instances, times, _jobs);
+        }
+    }
+    
+    // Palettes are written once per frame, along with the model matrices and the instance records of the crowd, and
+    // every context copies them
+    FrameProfiler::CpuScope scope(_profiler, "palette write");
+    _paletteFrame.clear();
+    if (_modelMesh) {
+        _modelMesh->setModelMatrix(glm::mat4(1.0));
+        _modelMesh->writePalette(_paletteFrame);
+    }
+    if (!_crowd.empty()) {
+        std::vector<AnimationInstance*> crowd;
+        for (std::unique_ptr<AnimationInstance> &instance : _crowd) {
+            crowd.push_back(instance.get());
+        }
+        AnimationInstance::writePalettes(crowd, _paletteFrame);
     }
 }
 
@@ -101,31 +282,40 @@ void App::onRenderGraphicsScene(const VRGraphicsState &renderState){
     GLfloat windowWidth = renderState.index().getValue("FramebufferWidth");
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), windowWidth / windowHeight, 0.01f, 500.0f);
     
-    // Set up model matrix;
-    glm::mat4 model = glm::mat4(1.0);
-    
+    // Update shader variables. The model matrix comes with the palette, which this context already copied for this
+    // frame, so only the view and projection change from one eye to the next.
+    ContextResources &resources = getContextResources();
+    SkinningShaders &shaders = resources.shaders;
+    shaders.setView(view, projection, eye_world);
     
-    // Update shader variables
-    _shader.use();
-    _shader.setUniform("view_mat", view);
-    _shader.setUniform("projection_mat", projection);
-    _shader.setUniform("model_mat", model);
-    _shader.setUniform("normal_mat", mat3(transpose(inverse(model))));
-    _shader.setUniform("eye_world", eye_world);
-    
-    //float time = (float) (VRSystem::getTime() - _startTime);
-    vector<glm::mat4> transforms;
-    
-    //_modelMesh->boneTransform(time, transforms);
+    // Draw the model, nothing until it has loaded. The queue sorts the draws and puts translucent ones last.
+    // The draw timers of every eye add up in the frame.
+    if (resources.hasPalettes) {
+        FrameProfiler::CpuScope cpuScope(_profiler, "draw");
+        FrameProfiler::GpuScope gpuScope(_profiler, "draw");
+        AnimationInstance::bindPalette(*resources.paletteBuffer, shaders);
+        const LodView lodView(eye_world, projection, windowHeight);
+        const LodView* lods = _useLods ? &lodView : nullptr;
+        if (!_crowd.empty()) {
+            std::vector<const AnimationInstance*> crowd;
+            for (const std::unique_ptr<AnimationInstance> &instance : _crowd) {
+                crowd.push_back(instance.get());
+            }
+            AnimationInstance::enqueueInstanced(crowd, *resources.paletteBuffer, resources.renderQueue, shaders, lods);
+        }
+        else if (_modelMesh) {
+            _modelMesh->enqueue(resources.renderQueue, shaders, lods);
+        }
+        resources.renderQueue.flush(view);
+    }
     
-    // Draw the model
-    _modelMesh->draw(_shader);
+    if (_showOverlay) {
+        FrameProfiler::GpuScope gpuScope(_profiler, "overlay");
+        resources.overlay->draw(_profiler, windowWidth, windowHeight);
+    }
 }
 
 void App::reloadShaders(){
-    _shader.compileShader("vertex.glsl", basicgraphics::GLSLShader::VERTEX);
-    _shader.compileShader("fragment.glsl", basicgraphics::GLSLShader::FRAGMENT);
-    _shader.link();
-    _shader.use();
+    getContextResources().shaders.compile("vertex.glsl", "fragment.glsl");
 }
 
@@ -13,6 +13,9 @@ using namespace MinVR;
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #ifdef _WIN32
@@ -39,6 +42,9 @@ using namespace MinVR;
 #include <BasicGraphics.h>
 
 #include "AnimatedModel.h"
+#include "AssetLoader.h"
+#include "FrameProfiler.h"
+#include "ProfilerOverlay.h"
 
 class App : public VRApp {
 public:
@@ -51,6 +57,7 @@ public:
     virtual void onButtonDown(const VRButtonEvent &state) override;
     virtual void onButtonUp(const VRButtonEvent &state) override;
     virtual void onCursorMove(const VRCursorEvent &state) override;
+    virtual void onGenericEvent(const VRDataIndex &event) override;
     
     
     /** RENDERING CALLBACKS **/
@@ -61,10 +68,50 @@ protected:
     
     double _startTime;
     
+    // MinVR renders every frame once per graphics context, and the scene once per eye or viewport of each context.
+    // The animation only changes once per frame: the FrameStart event, sent before any display renders, counts the
+    // frames and runs updateFrame, which evaluates every pose and writes the palettes on the CPU. Each context then
+    // copies them into its own palette buffer once, and every eye draws from that copy with its own view and projection.
+    int _frame;                     // frames started, 0 before the first
+    JobSystem _jobs;                // evaluates the crowd
+    PaletteFrame _paletteFrame;
+    virtual void updateFrame(int frame);
+    
+    // GL objects of one context. VAOs and queries are never shared between contexts, and MinVR does not have to share
+    // buffers, textures and programs either, so every context creates its own.
+    struct ContextResources {
+        SkinningShaders shaders;
+        std::unique_ptr<PaletteBuffer> paletteBuffer;
+        RenderQueue renderQueue;
+        std::unique_ptr<ProfilerOverlay> overlay;
+        int uploadedFrame = 0;      // last frame whose palettes were copied
+        bool hasPalettes = false;   // false if they did not fit
+    };
+    std::mutex _contextsMutex;
+    std::map<const void*, std::unique_ptr<ContextResources> > _contexts;     // by currentGLContext()
+    // Of the current context, created on first use
+    ContextResources& getContextResources();
+    
     virtual void reloadShaders();
-    basicgraphics::GLSLProgram _shader;
+    SkinningMode _skinningMode;     // D cycles through the skinning modes
+    bool _useLods;                  // L toggles levels of detail
+    
+    // Models are imported in the background, and each context shows them once it has uploaded them. The centers of
+    // rotation are only computed once optimized centers of rotation are selected, by importing the model again.
+    AssetLoader _loader;
+    AssetLoader::Handle _modelLoad;
+    bool _modelCenters;             // the model loaded or loading has centers of rotation
+    void loadModel(bool centersOfRotation);
     std::unique_ptr<AnimatedModel> _modelMesh;
+    // Models that were replaced, until every context that uploaded them has deleted its meshes
+    std::mutex _retiredMutex;
+    std::vector< std::shared_ptr<AnimatedModelAsset> > _retiredAssets;
+    std::vector< std::unique_ptr<AnimationInstance> > _crowd;  // C shows a grid of instances of the model instead
     std::unique_ptr<basicgraphics::Box> _box;
+    
+    // Times the stages of every frame. T shows the overlay, R and J record a CSV or JSON trace of every frame.
+    FrameProfiler _profiler;
+    bool _showOverlay;
 
     
 };
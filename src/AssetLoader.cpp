@@ -0,0 +1,152 @@
+//
+//  AssetLoader.cpp
+//
+
+#include "AssetLoader.h"
+
+#include <chrono>
+
+
+AssetLoader::Request::Request() : scale(1.0), stage(QUEUED), reporter(false), importTime(0.0)
+{
+    future = promise.get_future().share();
+}
+
+void AssetLoader::Request::finish(Stage finalStage, const std::shared_ptr<AnimatedModelAsset> &result)
+{
+    stage = finalStage;
+    promise.set_value(result);
+}
+
+
+AssetLoader::Handle::Handle()
+{
+}
+
+AssetLoader::Handle::Handle(const std::shared_ptr<Request> &request) : _request(request)
+{
+}
+
+bool AssetLoader::Handle::isValid() const
+{
+    return _request != nullptr;
+}
+
+const std::string& AssetLoader::Handle::getFilename() const
+{
+    return _request->filename;
+}
+
+AssetLoader::Stage AssetLoader::Handle::getStage() const
+{
+    return (Stage)_request->stage.load();
+}
+
+bool AssetLoader::Handle::isReady() const
+{
+    return getStage() == READY;
+}
+
+float AssetLoader::Handle::getProgress() const
+{
+    const Stage stage = getStage();
+    if (stage == QUEUED) {
+        return 0.0f;
+    }
+    return stage == IMPORTING ? _request->reporter.getProgress() : 1.0f;
+}
+
+double AssetLoader::Handle::getImportTime() const
+{
+    return getStage() == READY ? _request->importTime : 0.0;
+}
+
+std::shared_ptr<AnimatedModelAsset> AssetLoader::Handle::get() const
+{
+    return _request->future.get();
+}
+
+const std::shared_future<std::shared_ptr<AnimatedModelAsset> >& AssetLoader::Handle::getFuture() const
+{
+    return _request->future;
+}
+
+
+AssetLoader::AssetLoader() : _numPending(0), _quit(false)
+{
+    _worker = std::thread(&AssetLoader::workerLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wakeUp.notify_all();
+    _worker.join();
+    
+    // Nobody will import these any more
+    for (const std::shared_ptr<Request> &request : _toImport) {
+        request->finish(FAILED, nullptr);
+    }
+}
+
+AssetLoader::Handle AssetLoader::load(const std::string &filename, const double scale, glm::vec4 materialColor, const ImportSettings &settings)
+{
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->filename = filename;
+    request->scale = scale;
+    request->materialColor = materialColor;
+    request->settings = settings;
+    
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _toImport.push_back(request);
+        _numPending++;
+    }
+    _wakeUp.notify_one();
+    
+    return Handle(request);
+}
+
+int AssetLoader::getNumPending() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numPending;
+}
+
+void AssetLoader::workerLoop()
+{
+    while (true) {
+        std::shared_ptr<Request> request;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wakeUp.wait(lock, [this]() { return _quit || !_toImport.empty(); });
+            if (_quit) {
+                return;
+            }
+            request = _toImport.front();
+            _toImport.pop_front();
+        }
+        
+        request->stage = IMPORTING;
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        std::shared_ptr<AnimatedModelAsset> asset(new AnimatedModelAsset(request->filename, request->scale, request->materialColor, false,
+                                                                         request->settings, &request->reporter));
+        if (asset->isLoaded()) {
+            asset->decodeTextures(&_decodeJobs);
+        }
+        std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+        request->importTime = std::chrono::duration<double, std::milli>(end - start).count();
+        
+        std::lock_guard<std::mutex> lock(_mutex);
+        _numPending--;
+        if (asset->isLoaded()) {
+            request->finish(READY, asset);
+        }
+        else {
+            request->finish(FAILED, nullptr);
+        }
+    }
+}
@@ -0,0 +1,113 @@
+///
+///  AssetLoader.h
+///
+///  \brief Loads AnimatedModelAssets without stalling the frame. The import, vertex building and clip compression
+///         run on a worker thread, which then decodes the textures in parallel on a JobSystem. Assets are ready with
+///         their vertices and textures on the CPU, and every GL context drawing one uploads it to itself with
+///         AnimatedModelAsset::uploadToGPU. Each load returns a handle to poll or wait on.
+///
+
+#ifndef AssetLoader_hpp
+#define AssetLoader_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "AnimatedModelAsset.h"
+#include "JobSystem.h"
+
+
+class AssetLoader
+{
+    struct Request;
+
+public:
+    
+    enum Stage {
+        QUEUED,         // waiting for the worker
+        IMPORTING,      // on the worker thread
+        READY,          // imported and decoded, not uploaded to any context
+        FAILED          // the file could not be loaded, get() returns null
+    };
+    
+    class Handle
+    {
+    public:
+        
+        Handle();
+        
+        bool isValid() const;
+        const std::string& getFilename() const;
+        
+        Stage getStage() const;
+        bool isReady() const;
+        
+        // Progress of the import between 0 and 1, as reported to its ProgressReporter
+        float getProgress() const;
+        
+        // Milliseconds the worker spent importing the file and decoding its textures, known once READY
+        double getImportTime() const;
+        
+        // Waits until the asset is imported
+        std::shared_ptr<AnimatedModelAsset> get() const;
+        const std::shared_future<std::shared_ptr<AnimatedModelAsset> >& getFuture() const;
+    
+    private:
+        
+        friend class AssetLoader;
+        explicit Handle(const std::shared_ptr<Request> &request);
+        
+        std::shared_ptr<Request> _request;
+    };
+    
+    AssetLoader();
+    
+    // Finishes the asset being imported, then fails the others
+    ~AssetLoader();
+    
+    // Queues filename. The arguments are those of the AnimatedModelAsset constructor.
+    Handle load(const std::string &filename, const double scale, glm::vec4 materialColor = glm::vec4(1.0),
+                const ImportSettings &settings = ImportSettings());
+    
+    // Number of loads that are not ready or failed yet
+    int getNumPending() const;
+
+private:
+    
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+    
+    struct Request {
+        std::string filename;
+        double scale;
+        glm::vec4 materialColor;
+        ImportSettings settings;
+        
+        std::atomic<int> stage;
+        ProgressReporter reporter;
+        double importTime;                  // ms, written before the stage moves on
+        std::promise<std::shared_ptr<AnimatedModelAsset> > promise;
+        std::shared_future<std::shared_ptr<AnimatedModelAsset> > future;
+        
+        Request();
+        void finish(Stage stage, const std::shared_ptr<AnimatedModelAsset> &asset);
+    };
+    
+    mutable std::mutex _mutex;
+    std::condition_variable _wakeUp;
+    std::deque<std::shared_ptr<Request> > _toImport;
+    int _numPending;
+    bool _quit;
+    
+    std::thread _worker;
+    JobSystem _decodeJobs;                  // only used by _worker
+    
+    void workerLoop();
+};
+
+#endif /* AssetLoader_hpp */
@@ -6,18 +6,46 @@
 //
 
 #include "BoneMesh.h"
+#include "MeshBuffers.h"
 
 #include "glm/ext.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 
-BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, GLenum usage, int allocateVertexByteSize, int allocateIndexByteSize, int vertexOffset, const std::vector<Vertex> &data, int numIndices /*=0*/, int indexByteSize/*=0*/, int* index/*=nullptr*/)
+
+// Bytes per component of a vertex attribute of type
+static int attributeTypeSize(GLenum type)
+{
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, GLenum usage, int allocateVertexByteSize, int allocateIndexByteSize, int vertexOffset, const std::vector<Vertex> &data, int numIndices /*=0*/, int indexByteSize/*=0*/, const int* index/*=nullptr*/) :
+    BoneMesh(textures, primitiveType, usage, allocateVertexByteSize, allocateIndexByteSize, VertexFormat(), data.empty() ? nullptr : &data[0], (int)data.size() - vertexOffset, numIndices, indexByteSize, index)
+{
+}
+
+BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, GLenum usage, int allocateVertexByteSize, int allocateIndexByteSize, const VertexFormat &format, const void* data, int numVertices, int numIndices /*=0*/, int indexByteSize/*=0*/, const int* index/*=nullptr*/)
 {
     _textures = textures;
+    _format = format;
     
     _materialColor = glm::vec4(1.0);
     
-    assert(data.size() - vertexOffset >= 0);
-    int dataByteSize = sizeof(Vertex) * (data.size() - vertexOffset);
+    assert(numVertices >= 0);
+    const int stride = format.getStride();
+    int dataByteSize = stride * numVertices;
     
     _allocatedVertexByteSize = allocateVertexByteSize;
     _allocatedIndexByteSize = allocateIndexByteSize;
@@ -25,6 +53,11 @@ BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > texture
     _filledIndexByteSize = indexByteSize;
     _numIndices = numIndices;
     _primitiveType = primitiveType;
+    _centerVBO = 0;
+    _baseVertex = 0;
+    _firstIndex = 0;
+    _sharedCenters = false;
+    setDrawRanges(std::vector<DrawRange>());
     
     // create the vao
     glGenVertexArrays(1, &_vaoID);
@@ -39,20 +72,10 @@ BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > texture
     
     if (dataByteSize > 0) {
         //buffer data
-        glBufferSubData(GL_ARRAY_BUFFER, 0, dataByteSize, &data[0]);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, dataByteSize, data);
     }
     
-    // set up vertex attributes
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord0));
-    glEnableVertexAttribArray(3);
-    glVertexAttribIPointer(3, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, IDs));
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, weights));
+    setAttributes(format);
     
     // Create indexstream
     glGenBuffers(1, &_indexVBO);
@@ -69,52 +92,94 @@ BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > texture
     glBindVertexArray(0);
 }
 
+BoneMesh::BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, const std::shared_ptr<MeshBuffers> &buffers, int baseVertex, int firstIndex, int numVertices, int numIndices, bool centersOfRotation)
+{
+    _textures = textures;
+    _format = buffers->getVertexFormat();
+    
+    _materialColor = glm::vec4(1.0);
+    
+    _allocatedVertexByteSize = _format.getStride() * numVertices;
+    _allocatedIndexByteSize = buffers->getIndexSize() * numIndices;
+    _filledVertexByteSize = _allocatedVertexByteSize;
+    _filledIndexByteSize = _allocatedIndexByteSize;
+    _numIndices = numIndices;
+    _primitiveType = primitiveType;
+    
+    _buffers = buffers;
+    _vaoID = buffers->getVAOID();
+    _vertexVBO = 0;
+    _indexVBO = 0;
+    _centerVBO = 0;
+    _baseVertex = baseVertex;
+    _firstIndex = firstIndex;
+    _sharedCenters = centersOfRotation && buffers->hasCentersOfRotation();
+    setDrawRanges(std::vector<DrawRange>());
+}
+
 BoneMesh::~BoneMesh()
 {
+    // The shared buffers are deleted with the last mesh using them
+    if (_buffers) {
+        return;
+    }
+    
     //Assumes object is deleted with the correct context current
     glDeleteBuffers(1, &_vertexVBO);
     glDeleteBuffers(1, &_indexVBO);
+    if (_centerVBO != 0) {
+        glDeleteBuffers(1, &_centerVBO);
+    }
     glDeleteVertexArrays(1, &_vaoID);
 }
 
 void BoneMesh::draw(basicgraphics::GLSLProgram &shader) {
     
-    bool translucent = false;
-    if (_textures.size() > 0) {
-        //std::cout<<"Mesh has texture"<<std::endl;
-        shader.setUniform("hasTexture", 1);
-        shader.setUniform("materialColor", vec4(0.0, 0.0, 0.0, 1.0));
-        
-        for (int i = 0; i < _textures.size(); i++) {
-            
-            if (!_textures[i]->isOpaque()) {
-                translucent = true;
-                glDisable(GL_DEPTH_TEST);
-                //Note: This isn't going to work properly because the surfaces are not sorted back to front. Transparent surfaces should be drawn after all the opaque geometry.
-                glEnable(GL_BLEND);
-                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-            }
-            _textures[i]->bind(i);
-            shader.setUniform("textureSampler", i);
-        }
-    }
-    else {
-        //std::cout<<"Mesh does not have texture"<<std::endl;
-        shader.setUniform("hasTexture", 0);
-        shader.setUniform("materialColor", _materialColor);
-        if (_materialColor.a != 1.0) {
-            translucent = true;
-            glDisable(GL_DEPTH_TEST);
-            //Note: This isn't going to work properly because the surfaces are not sorted back to front. Transparent surfaces should be drawn after all the opaque geometry.
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-        }
-    }
+    const bool translucent = bindMaterial();
+    setMaterialUniforms(shader);
     
     glBindVertexArray(this->getVAOID());
-    glDrawElements(_primitiveType, _numIndices, GL_UNSIGNED_INT, 0);
+    glDrawElementsBaseVertex(_primitiveType, _numIndices, getIndexType(), getIndexOffset(_firstIndex), _baseVertex);
     glBindVertexArray(0);
     
+    unbindMaterial(translucent);
+}
+
+void BoneMesh::draw(SkinningShaders &shaders, SkinningMode mode) {
+    
+    mode = getDrawMode(mode);
+    const bool translucent = bindMaterial();
+    
+    glBindVertexArray(this->getVAOID());
+    for (const DrawRange &range : _drawRanges) {
+        basicgraphics::GLSLProgram &shader = shaders.use(range.numInfluences, mode);
+        setMaterialUniforms(shader);
+        glDrawElementsBaseVertex(_primitiveType, range.numIndices, getIndexType(), getIndexOffset(_firstIndex + range.firstIndex), _baseVertex);
+    }
+    glBindVertexArray(0);
+    
+    unbindMaterial(translucent);
+}
+
+// Binds the textures and enables blending for translucent materials. Returns whether blending was enabled.
+bool BoneMesh::bindMaterial()
+{
+    for (int i = 0; i < _textures.size(); i++) {
+        _textures[i]->bind(i);
+    }
+    
+    const bool translucent = isTranslucent();
+    if (translucent) {
+        glDisable(GL_DEPTH_TEST);
+        //Note: Drawing a single mesh cannot sort its surfaces against the rest of the scene, RenderQueue draws translucent surfaces back to front after all the opaque geometry.
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    }
+    return translucent;
+}
+
+void BoneMesh::unbindMaterial(bool translucent)
+{
     if (translucent) {
         glBlendFunc(GL_ONE, GL_ZERO);
         glDisable(GL_BLEND);
@@ -129,6 +194,23 @@ void BoneMesh::draw(basicgraphics::GLSLProgram &shader) {
     }
 }
 
+void BoneMesh::setMaterialUniforms(basicgraphics::GLSLProgram &shader) const
+{
+    if (_textures.size() > 0) {
+        shader.setUniform("hasTexture", 1);
+        shader.setUniform("materialColor", vec4(0.0, 0.0, 0.0, 1.0));
+        for (int i = 0; i < _textures.size(); i++) {
+            shader.setUniform("textureSampler", i);
+        }
+    }
+    else {
+        shader.setUniform("hasTexture", 0);
+        shader.setUniform("materialColor", _materialColor);
+    }
+    
+    shader.setUniform("octahedralNormals", _format.octahedralNormals ? 1 : 0);
+}
+
 void BoneMesh::setMaterialColor(const glm::vec4 &color)
 {
     _materialColor = color;
@@ -164,8 +246,128 @@ GLuint BoneMesh::getVAOID() const
     return _vaoID;
 }
 
+const BoneMesh::VertexFormat& BoneMesh::getVertexFormat() const
+{
+    return _format;
+}
+
+const std::shared_ptr<MeshBuffers>& BoneMesh::getSharedBuffers() const
+{
+    return _buffers;
+}
+
+int BoneMesh::getBaseVertex() const
+{
+    return _baseVertex;
+}
+
+int BoneMesh::getFirstIndex() const
+{
+    return _firstIndex;
+}
+
+GLenum BoneMesh::getIndexType() const
+{
+    return _buffers ? _buffers->getIndexType() : GL_UNSIGNED_INT;
+}
+
+const void* BoneMesh::getIndexOffset(int index) const
+{
+    const size_t indexSize = _buffers ? _buffers->getIndexSize() : sizeof(int);
+    return (const void*)(indexSize * (size_t)index);
+}
+
+bool BoneMesh::hasSameMaterial(const BoneMesh &other) const
+{
+    return _textures == other._textures && _materialColor == other._materialColor;
+}
+
+bool BoneMesh::isTranslucent() const
+{
+    if (_textures.empty()) {
+        return _materialColor.a != 1.0;
+    }
+    for (int i = 0; i < _textures.size(); i++) {
+        if (!_textures[i]->isOpaque()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const std::vector<std::shared_ptr<basicgraphics::Texture> >& BoneMesh::getTextures() const
+{
+    return _textures;
+}
+
+GLenum BoneMesh::getPrimitiveType() const
+{
+    return _primitiveType;
+}
+
+void BoneMesh::setCentersOfRotation(const glm::vec3* centers, int numVertices)
+{
+    assert(!_buffers);
+    glBindVertexArray(_vaoID);
+    
+    if (_centerVBO == 0) {
+        glGenBuffers(1, &_centerVBO);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, _centerVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * numVertices, centers, GL_STATIC_DRAW);
+    
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    
+    glBindVertexArray(0);
+}
+
+bool BoneMesh::hasCentersOfRotation() const
+{
+    return _centerVBO != 0 || _sharedCenters;
+}
+
+SkinningMode BoneMesh::getDrawMode(SkinningMode mode) const
+{
+    if (mode == OPTIMIZED_CENTERS_OF_ROTATION && !hasCentersOfRotation()) {
+        return LINEAR_BLEND_SKINNING;
+    }
+    return mode;
+}
+
+void BoneMesh::setDrawRanges(const std::vector<DrawRange> &ranges)
+{
+    _drawRanges = ranges;
+    if (_drawRanges.empty()) {
+        DrawRange all = { NUM_BONES_PER_VERTEX, 0, _numIndices };
+        _drawRanges.push_back(all);
+    }
+}
+
+const std::vector<BoneMesh::DrawRange>& BoneMesh::getDrawRanges() const
+{
+    return _drawRanges;
+}
+
+void BoneMesh::setLodDrawRanges(const std::vector< std::vector<DrawRange> > &lods)
+{
+    _lodDrawRanges = lods;
+}
+
+int BoneMesh::getNumLods() const
+{
+    return 1 + (int)_lodDrawRanges.size();
+}
+
+const std::vector<BoneMesh::DrawRange>& BoneMesh::getDrawRanges(int lod) const
+{
+    lod = std::min(lod, (int)_lodDrawRanges.size());
+    return lod == 0 ? _drawRanges : _lodDrawRanges[lod - 1];
+}
+
 void BoneMesh::updateVertexData(int startByteOffset, int vertexOffset, const std::vector<Vertex> &data)
 {
+    assert(!_buffers && _format.isFull());
     assert(startByteOffset <= _filledVertexByteSize);
     
     int dataByteSize = sizeof(Vertex)*((int)data.size() - vertexOffset);
@@ -181,8 +383,9 @@ void BoneMesh::updateVertexData(int startByteOffset, int vertexOffset, const std
     glBufferSubData(GL_ARRAY_BUFFER, startByteOffset, dataByteSize, &data[0]);
 }
 
-void BoneMesh::updateIndexData(int totalNumIndices, int startByteOffset, int indexByteSize, int* index)
+void BoneMesh::updateIndexData(int totalNumIndices, int startByteOffset, int indexByteSize, const int* index)
 {
+    assert(!_buffers);
     assert(startByteOffset <= _filledIndexByteSize);
     _numIndices = totalNumIndices;
     int totalBytes = startByteOffset + indexByteSize;
@@ -192,26 +395,37 @@ void BoneMesh::updateIndexData(int totalNumIndices, int startByteOffset, int ind
     assert(_filledIndexByteSize <= _allocatedIndexByteSize);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexVBO);
     glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, startByteOffset, indexByteSize, index);
+    setDrawRanges(std::vector<DrawRange>());
 }
 
-//Adds bone data to a vertex. Looks for the next open slot on the VBO, and puts the boneID and weight in that slot
-void BoneMesh::Vertex::AddBoneData(int BoneID, float Weight) {
-    for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
-        if (weights[i] == 0) {
-            IDs[i] = BoneID;
-            weights[i] = Weight;
-            
-//            std::cout << std::endl << "Position: " << glm::to_string(position) << std::endl << "ID: ";
-//            for (uint id: IDs) { std::cout << id << "\t"; };
-//            std::cout << std::endl << "Weights: ";
-//            float sum = 0;
-//            for (float weight: weights) { std::cout << weight << "\t"; sum += weight; };
-//            std::cout << std::endl << sum << std::endl;
-            
-            return;
-        }
+// The component types of VertexFormat are the GL enums
+static_assert(VERTEX_UNSIGNED_BYTE == GL_UNSIGNED_BYTE && VERTEX_UNSIGNED_SHORT == GL_UNSIGNED_SHORT && VERTEX_UNSIGNED_INT == GL_UNSIGNED_INT
+              && VERTEX_FLOAT == GL_FLOAT, "VertexFormat types must match GL");
+
+void BoneMesh::setAttributes(const VertexFormat &format)
+{
+    const int stride = format.getStride();
+    
+    // Bone IDs and weights take two vec4 inputs each, for the 8 influences
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    glEnableVertexAttribArray(1);
+    if (format.octahedralNormals) {
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)(size_t)format.getNormalOffset());
     }
+    else {
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(size_t)format.getNormalOffset());
+    }
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, format.halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)(size_t)format.getTexCoordOffset());
     
-    // more bones than we have space for
-    assert(0);
+    const int boneIDSize = attributeTypeSize(format.boneIDType);
+    const int weightSize = attributeTypeSize(format.weightType);
+    for (int i = 0; i < 2; i++) {
+        glEnableVertexAttribArray(3 + i);
+        glVertexAttribIPointer(3 + i, 4, format.boneIDType, stride, (void*)(size_t)(format.getBoneIDOffset() + 4 * i * boneIDSize));
+        glEnableVertexAttribArray(5 + i);
+        glVertexAttribPointer(5 + i, 4, format.weightType, format.weightType != GL_FLOAT, stride,
+                              (void*)(size_t)(format.getWeightOffset() + 4 * i * weightSize));
+    }
 }
@@ -34,38 +34,36 @@
 
 #include "Texture.h"
 #include "GLSLProgram.h"
+#include "SkinningShaders.h"
+#include "SkinnedVertex.h"
 
+class MeshBuffers;
 
 class BoneMesh : public std::enable_shared_from_this<BoneMesh>
 {
 public:
     
-    #define NUM_BONES_PER_VERTEX 8
-    
-    struct Vertex {        
-        glm::vec3 position;
-        glm::vec3 normal;
-        glm::vec2 texCoord0;
-        uint IDs[NUM_BONES_PER_VERTEX];
-        float weights[NUM_BONES_PER_VERTEX];
-
-        Vertex() {           
-            position = glm::vec3(0.0);
-            normal = glm::vec3(0.0);
-            texCoord0 = glm::vec2(0.0);
-            std::memset(IDs, 0, sizeof(uint) * NUM_BONES_PER_VERTEX);
-            std::memset(weights, 0, sizeof(float) * NUM_BONES_PER_VERTEX);
-        };
-        
-        void AddBoneData(int BoneID, float Weight);
-    };
+    // The CPU side types, see SkinnedVertex.h
+    typedef SkinnedVertex Vertex;
+    typedef ::DrawRange DrawRange;
+    typedef ::VertexFormat VertexFormat;
     
+    // Points the inputs of vertex.glsl at vertices in format in the GL_ARRAY_BUFFER, for the bound VAO
+    static void setAttributes(const VertexFormat &format);
     
     // Creates a vao and vbo. Usage should be GL_STATIC_DRAW, GL_DYNAMIC_DRAW, etc. Leave data empty to just allocate but not upload.
-    BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, GLenum usage, int allocateVertexByteSize, int allocateIndexByteSize, int vertexOffset, const std::vector<Vertex> &data, int numIndices = 0, int indexByteSize = 0, int* index = nullptr);
+    BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, GLenum usage, int allocateVertexByteSize, int allocateIndexByteSize, int vertexOffset, const std::vector<Vertex> &data, int numIndices = 0, int indexByteSize = 0, const int* index = nullptr);
+    // Same, uploading numVertices vertices stored in format straight from data, which may point into a mapped file
+    BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, GLenum usage, int allocateVertexByteSize, int allocateIndexByteSize, const VertexFormat &format, const void* data, int numVertices, int numIndices = 0, int indexByteSize = 0, const int* index = nullptr);
+    // Draws numIndices indices from firstIndex, offset by baseVertex, in buffers shared with other meshes instead of
+    // owning a vao and vbos. centersOfRotation tells whether this mesh's part of buffers has them. Cannot be updated.
+    BoneMesh(std::vector<std::shared_ptr<basicgraphics::Texture> > textures, GLenum primitiveType, const std::shared_ptr<MeshBuffers> &buffers, int baseVertex, int firstIndex, int numVertices, int numIndices, bool centersOfRotation);
     virtual ~BoneMesh();
 
+    // Draws every index with shader, which has to read all NUM_BONES_PER_VERTEX influences
     virtual void draw(basicgraphics::GLSLProgram &shader);
+    // Draws each draw range with its variant of shaders
+    virtual void draw(SkinningShaders &shaders, SkinningMode mode = LINEAR_BLEND_SKINNING);
     
     void setMaterialColor(const glm::vec4 &color);
     
@@ -78,28 +76,78 @@ public:
     int getNumIndices() const;
     
     GLuint getVAOID() const;
+    const VertexFormat& getVertexFormat() const;
+    
+    // Null unless the mesh lives in buffers shared with other meshes, at getBaseVertex() and getFirstIndex()
+    const std::shared_ptr<MeshBuffers>& getSharedBuffers() const;
+    int getBaseVertex() const;
+    int getFirstIndex() const;
+    
+    // True if the material is the same as other's, so that their draws can be merged
+    bool hasSameMaterial(const BoneMesh &other) const;
+    // Blended over what is behind it: a texture with alpha, or a material color that is not opaque
+    bool isTranslucent() const;
+    const std::vector<std::shared_ptr<basicgraphics::Texture> >& getTextures() const;
+    GLenum getPrimitiveType() const;
+    // Sets the material and vertex format uniforms of shader, which must be in use
+    void setMaterialUniforms(basicgraphics::GLSLProgram &shader) const;
+    
+    // Uploads one center of rotation per vertex to a second vertex buffer, read by OPTIMIZED_CENTERS_OF_ROTATION
+    void setCentersOfRotation(const glm::vec3* centers, int numVertices);
+    bool hasCentersOfRotation() const;
     
+    // Mode the mesh is drawn with when mode is asked for: meshes without centers of rotation use linear blend skinning
+    SkinningMode getDrawMode(SkinningMode mode) const;
     
-    // Update the vbos. startByteOffset+dataByteSize must be <= allocatedByteSize
+    // Defaults to a single range of NUM_BONES_PER_VERTEX influences over every index
+    void setDrawRanges(const std::vector<DrawRange> &ranges);
+    const std::vector<DrawRange>& getDrawRanges() const;
+    
+    // Ranges of the coarser levels of detail, from level 1, in the same vertices as the mesh. Their first indices are
+    // relative to getFirstIndex() like those of the mesh, but lie after all the meshes of the shared buffers.
+    void setLodDrawRanges(const std::vector< std::vector<DrawRange> > &lods);
+    int getNumLods() const;
+    // Ranges of level lod, or of the coarsest level the mesh has
+    const std::vector<DrawRange>& getDrawRanges(int lod) const;
+    
+    
+    // Update the vbos. startByteOffset+dataByteSize must be <= allocatedByteSize. Vertices can only be updated in the full format.
+    // Updating the indices resets the draw ranges.
     void updateVertexData(int startByteOffset, int vertexOffset, const std::vector<Vertex> &data);
-    void updateIndexData(int totalNumIndices, int startByteOffset, int indexByteSize, int* index);
+    void updateIndexData(int totalNumIndices, int startByteOffset, int indexByteSize, const int* index);
     
 private:
         
     GLuint _vaoID;
     GLuint _vertexVBO;
     GLuint _indexVBO;
+    GLuint _centerVBO;
     GLenum _primitiveType;
+    VertexFormat _format;
+    
+    std::shared_ptr<MeshBuffers> _buffers;
+    int _baseVertex;
+    int _firstIndex;
+    bool _sharedCenters;                // the part of _buffers of this mesh has centers of rotation
     
     int _allocatedVertexByteSize;
     int _allocatedIndexByteSize;
     int _filledVertexByteSize;
     int _filledIndexByteSize;
     int _numIndices;
+    std::vector<DrawRange> _drawRanges;
+    std::vector< std::vector<DrawRange> > _lodDrawRanges;
     
     glm::vec4 _materialColor;
     
     std::vector<std::shared_ptr<basicgraphics::Texture> > _textures;
+    
+    bool bindMaterial();
+    void unbindMaterial(bool translucent);
+    
+    // Type of the indices and byte offset of index in the index buffer, which are 16 bit in some shared buffers
+    GLenum getIndexType() const;
+    const void* getIndexOffset(int index) const;
 };
 
 #endif /* BoneMesh_hpp */
@@ -0,0 +1,291 @@
+//
+//  CentersOfRotation.cpp
+//
+
+#include "CentersOfRotation.h"
+#include "CookedAsset.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CENTERS_OF_ROTATION_SSE
+#endif
+
+#define CENTERS_OF_ROTATION_MAGIC "YACOR"
+#define CENTERS_OF_ROTATION_VERSION 1
+
+
+// Triangles whose averaged weights involve at least two bones, in streams of one value per triangle
+struct BlendedTriangles {
+    int count;
+    int paddedCount;                            // multiple of 4, the padding has zero area and weights
+    std::vector<float> area;
+    std::vector<float> weightedCentroid[3];     // centroid times area
+    std::vector<int> boneColumn;                // per bone, the start of its weights in weights or -1 if unused
+    std::vector<float> weights;                 // paddedCount per used bone
+};
+
+static void gatherBlendedTriangles(const SkinnedVertex* vertices, const int* indices, int numIndices, int numBones, BlendedTriangles &triangles)
+{
+    std::vector<int> blended;
+    for (int t = 0; t + 2 < numIndices; t += 3) {
+        int firstBone = -1;
+        bool severalBones = false;
+        for (int c = 0; c < 3 && !severalBones; c++) {
+            const SkinnedVertex &vertex = vertices[indices[t + c]];
+            for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+                if (vertex.weights[i] > 0.0f) {
+                    if (firstBone < 0) {
+                        firstBone = (int)vertex.IDs[i];
+                    }
+                    else if ((int)vertex.IDs[i] != firstBone) {
+                        severalBones = true;
+                        break;
+                    }
+                }
+            }
+        }
+        if (severalBones) {
+            blended.push_back(t);
+        }
+    }
+    
+    triangles.count = (int)blended.size();
+    triangles.paddedCount = (triangles.count + 3) & ~3;
+    triangles.area.assign(triangles.paddedCount, 0.0f);
+    for (int c = 0; c < 3; c++) {
+        triangles.weightedCentroid[c].assign(triangles.paddedCount, 0.0f);
+    }
+    triangles.boneColumn.assign(numBones, -1);
+    triangles.weights.clear();
+    
+    for (int k = 0; k < triangles.count; k++) {
+        const int t = blended[k];
+        const SkinnedVertex &a = vertices[indices[t]];
+        const SkinnedVertex &b = vertices[indices[t + 1]];
+        const SkinnedVertex &c = vertices[indices[t + 2]];
+        
+        const float area = 0.5f * glm::length(glm::cross(b.position - a.position, c.position - a.position));
+        const glm::vec3 centroid = (a.position + b.position + c.position) / 3.0f;
+        triangles.area[k] = area;
+        for (int axis = 0; axis < 3; axis++) {
+            triangles.weightedCentroid[axis][k] = area * centroid[axis];
+        }
+        
+        const SkinnedVertex* corners[3] = { &a, &b, &c };
+        for (const SkinnedVertex* corner : corners) {
+            for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+                if (corner->weights[i] <= 0.0f) {
+                    continue;
+                }
+                int &column = triangles.boneColumn[corner->IDs[i]];
+                if (column < 0) {
+                    column = (int)triangles.weights.size();
+                    triangles.weights.resize(triangles.weights.size() + triangles.paddedCount, 0.0f);
+                }
+                triangles.weights[column + k] += corner->weights[i] / 3.0f;
+            }
+        }
+    }
+}
+
+#ifdef CENTERS_OF_ROTATION_SSE
+// e^x for x <= 0, as 2^integer times a polynomial for 2^fraction. Relative error below 1e-4, plenty for a weight.
+static inline __m128 expNegative(__m128 x)
+{
+    const __m128 t = _mm_mul_ps(_mm_max_ps(x, _mm_set1_ps(-87.0f)), _mm_set1_ps(1.44269504f));
+    __m128 whole = _mm_cvtepi32_ps(_mm_cvttps_epi32(t));
+    whole = _mm_sub_ps(whole, _mm_and_ps(_mm_cmpgt_ps(whole, t), _mm_set1_ps(1.0f)));
+    const __m128 fraction = _mm_sub_ps(t, whole);
+    
+    __m128 p = _mm_set1_ps(1.33335581e-3f);
+    p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(9.61812911e-3f));
+    p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(5.55041087e-2f));
+    p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(2.40226507e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(6.93147182e-1f));
+    p = _mm_add_ps(_mm_mul_ps(p, fraction), _mm_set1_ps(1.0f));
+    
+    const __m128i exponent = _mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(whole), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(p, _mm_castsi128_ps(exponent));
+}
+#endif
+
+// Adds the term of the bone pair (j, k) of a vertex to the similarity of every triangle:
+// wj * wk * tj * tk * exp(-(wj * tk - wk * tj)^2 / sigma^2). The paper sums ordered pairs, the factor 2 cancels out.
+static void addPairSimilarity(float wj, float wk, const float* tj, const float* tk, int paddedCount, float invSigmaSquared, float* similarity)
+{
+#ifdef CENTERS_OF_ROTATION_SSE
+    const __m128 vwj = _mm_set1_ps(wj);
+    const __m128 vwk = _mm_set1_ps(wk);
+    const __m128 scale = _mm_set1_ps(-invSigmaSquared);
+    for (int t = 0; t < paddedCount; t += 4) {
+        const __m128 vtj = _mm_loadu_ps(tj + t);
+        const __m128 vtk = _mm_loadu_ps(tk + t);
+        const __m128 difference = _mm_sub_ps(_mm_mul_ps(vwj, vtk), _mm_mul_ps(vwk, vtj));
+        const __m128 gaussian = expNegative(_mm_mul_ps(_mm_mul_ps(difference, difference), scale));
+        const __m128 term = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(vwj, vwk), _mm_mul_ps(vtj, vtk)), gaussian);
+        _mm_storeu_ps(similarity + t, _mm_add_ps(_mm_loadu_ps(similarity + t), term));
+    }
+#else
+    for (int t = 0; t < paddedCount; t++) {
+        const float difference = wj * tk[t] - wk * tj[t];
+        similarity[t] += wj * wk * tj[t] * tk[t] * std::exp(-difference * difference * invSigmaSquared);
+    }
+#endif
+}
+
+// Center of rotation for the weights of one vertex. Returns false when no triangle is similar.
+static bool solveCenter(const SkinnedVertex &vertex, const BlendedTriangles &triangles, float invSigmaSquared,
+                        std::vector<float> &similarity, glm::vec3 &center)
+{
+    similarity.assign(triangles.paddedCount, 0.0f);
+    
+    bool anyPair = false;
+    for (int j = 0; j < NUM_BONES_PER_VERTEX; j++) {
+        const int columnJ = vertex.weights[j] > 0.0f ? triangles.boneColumn[vertex.IDs[j]] : -1;
+        if (columnJ < 0) {
+            continue;
+        }
+        for (int k = j + 1; k < NUM_BONES_PER_VERTEX; k++) {
+            const int columnK = vertex.weights[k] > 0.0f ? triangles.boneColumn[vertex.IDs[k]] : -1;
+            if (columnK < 0 || columnK == columnJ) {
+                continue;
+            }
+            addPairSimilarity(vertex.weights[j], vertex.weights[k], &triangles.weights[columnJ], &triangles.weights[columnK],
+                              triangles.paddedCount, invSigmaSquared, &similarity[0]);
+            anyPair = true;
+        }
+    }
+    if (!anyPair) {
+        return false;
+    }
+    
+    double total = 0.0;
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (int t = 0; t < triangles.count; t++) {
+        total += similarity[t] * triangles.area[t];
+        for (int axis = 0; axis < 3; axis++) {
+            sum[axis] += similarity[t] * triangles.weightedCentroid[axis][t];
+        }
+    }
+    if (total <= 1e-12) {
+        return false;
+    }
+    
+    center = glm::vec3((float)(sum[0] / total), (float)(sum[1] / total), (float)(sum[2] / total));
+    return true;
+}
+
+// Orders vertices by their weights, so that vertices with the same ones are only solved once
+struct WeightsLess {
+    bool operator()(const SkinnedVertex* a, const SkinnedVertex* b) const
+    {
+        const int ids = std::memcmp(a->IDs, b->IDs, sizeof(a->IDs));
+        if (ids != 0) {
+            return ids < 0;
+        }
+        return std::memcmp(a->weights, b->weights, sizeof(a->weights)) < 0;
+    }
+};
+
+void computeCentersOfRotation(const SkinnedVertex* vertices, int numVertices, const int* indices, int numIndices,
+                              float sigma, JobSystem &jobs, std::vector<glm::vec3> &centers)
+{
+    centers.resize(numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        centers[v] = vertices[v].position;
+    }
+    
+    int numBones = 0;
+    std::map<const SkinnedVertex*, int, WeightsLess> uniqueIndex;
+    std::vector<const SkinnedVertex*> unique;
+    std::vector<int> vertexUnique(numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+            numBones = std::max(numBones, (int)vertices[v].IDs[i] + 1);
+        }
+        std::map<const SkinnedVertex*, int, WeightsLess>::const_iterator found = uniqueIndex.find(&vertices[v]);
+        if (found == uniqueIndex.end()) {
+            found = uniqueIndex.insert(std::make_pair(&vertices[v], (int)unique.size())).first;
+            unique.push_back(&vertices[v]);
+        }
+        vertexUnique[v] = found->second;
+    }
+    
+    BlendedTriangles triangles;
+    gatherBlendedTriangles(vertices, indices, numIndices, numBones, triangles);
+    if (triangles.count == 0) {
+        return;
+    }
+    
+    const float invSigmaSquared = 1.0f / (sigma * sigma);
+    std::vector<glm::vec3> uniqueCenters(unique.size());
+    std::vector<char> solved(unique.size(), 0);
+    
+    jobs.parallelFor((int)unique.size(), 16, [&](int begin, int end) {
+        std::vector<float> similarity;
+        for (int u = begin; u < end; u++) {
+            solved[u] = solveCenter(*unique[u], triangles, invSigmaSquared, similarity, uniqueCenters[u]);
+        }
+    });
+    
+    for (int v = 0; v < numVertices; v++) {
+        if (solved[vertexUnique[v]]) {
+            centers[v] = uniqueCenters[vertexUnique[v]];
+        }
+    }
+}
+
+// FNV-1a
+static void hashBytes(uint64_t &hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    }
+}
+
+uint64_t hashSkinnedMesh(const SkinnedVertex* vertices, int numVertices, const int* indices, int numIndices, float sigma)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hashBytes(hash, &sigma, sizeof(sigma));
+    for (int v = 0; v < numVertices; v++) {
+        hashBytes(hash, &vertices[v].position, sizeof(vertices[v].position));
+        hashBytes(hash, vertices[v].IDs, sizeof(vertices[v].IDs));
+        hashBytes(hash, vertices[v].weights, sizeof(vertices[v].weights));
+    }
+    hashBytes(hash, indices, sizeof(int) * (size_t)numIndices);
+    return hash;
+}
+
+bool loadCentersOfRotation(const std::string &cacheFile, uint64_t hash, int numVertices, std::vector<glm::vec3> &centers)
+{
+    MappedFile file(cacheFile);
+    if (!file.isOpen()) {
+        return false;
+    }
+    
+    CookedReader reader(file.getData(), file.getSize());
+    const std::string magic = reader.readString();
+    const uint32_t version = reader.read<uint32_t>();
+    const uint64_t fileHash = reader.read<uint64_t>();
+    reader.readArray(centers);
+    
+    return !reader.hasFailed() && magic == CENTERS_OF_ROTATION_MAGIC && version == CENTERS_OF_ROTATION_VERSION &&
+           fileHash == hash && (int)centers.size() == numVertices;
+}
+
+bool saveCentersOfRotation(const std::string &cacheFile, uint64_t hash, const std::vector<glm::vec3> &centers)
+{
+    CookedWriter writer(cacheFile);
+    writer.writeString(CENTERS_OF_ROTATION_MAGIC);
+    writer.write((uint32_t)CENTERS_OF_ROTATION_VERSION);
+    writer.write(hash);
+    writer.writeArray(centers);
+    return writer.isOpen();
+}
@@ -0,0 +1,40 @@
+///
+///  CentersOfRotation.h
+///
+///  \brief Precomputation for skinning with optimized centers of rotation (Le and Hodgins 2016). The center of a
+///         vertex is the area weighted average of the triangle centroids, each weighted by how similar the skinning
+///         weights of the triangle are to the vertex's own. At runtime the vertex is rotated about its center by the
+///         blended bone rotation and the center itself is moved by linear blend skinning.
+///
+///         Finding the centers compares every vertex with every triangle, so vertices with the same weights are solved
+///         once, triangles bound to a single bone are left out since they never contribute, the remaining triangles
+///         are compared four at a time with SSE2 across all threads, and the results are cached on disk.
+///
+
+#ifndef CentersOfRotation_hpp
+#define CentersOfRotation_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "SkinnedVertex.h"
+#include "JobSystem.h"
+
+
+// Width of the similarity kernel from the paper. Smaller values only let triangles with closer weights contribute.
+#define CENTERS_OF_ROTATION_SIGMA 0.1f
+#define CENTERS_OF_ROTATION_EXTENSION ".cor"
+
+// Centers of rotation of vertices, one per vertex. Vertices that no triangle is similar to, like those bound to a
+// single bone, get their own position, for which the runtime path reduces to linear blend skinning.
+void computeCentersOfRotation(const SkinnedVertex* vertices, int numVertices, const int* indices, int numIndices,
+                              float sigma, JobSystem &jobs, std::vector<glm::vec3> &centers);
+
+// Identifies the positions, weights and triangles of a mesh, and sigma, for the disk cache
+uint64_t hashSkinnedMesh(const SkinnedVertex* vertices, int numVertices, const int* indices, int numIndices, float sigma);
+
+// Reads the centers saved to cacheFile for the mesh with the given hash. Returns false if there are none.
+bool loadCentersOfRotation(const std::string &cacheFile, uint64_t hash, int numVertices, std::vector<glm::vec3> &centers);
+bool saveCentersOfRotation(const std::string &cacheFile, uint64_t hash, const std::vector<glm::vec3> &centers);
+
+#endif /* CentersOfRotation_hpp */
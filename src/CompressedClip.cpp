@@ -0,0 +1,273 @@
+//
+//  CompressedClip.cpp
+//
+
+#include "CompressedClip.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+static float maxDifference(const glm::vec3 &a, const glm::vec3 &b)
+{
+    return std::max(std::fabs(a.x - b.x), std::max(std::fabs(a.y - b.y), std::fabs(a.z - b.z)));
+}
+
+static float maxDifference(const glm::vec4 &a, const glm::vec4 &b)
+{
+    return std::max(maxDifference(glm::vec3(a), glm::vec3(b)), std::fabs(a.w - b.w));
+}
+
+static glm::vec3 lerpVector(const glm::vec3 &a, const glm::vec3 &b, float factor)
+{
+    return a + factor * (b - a);
+}
+
+// Same interpolation as composeTRS, so that dropping a key is judged by what playback will actually show
+static glm::vec4 nlerpRotation(const glm::vec4 &a, const glm::vec4 &b, float factor)
+{
+    const glm::vec4 end = glm::dot(a, b) < 0.0f ? -b : b;
+    return glm::normalize(a + factor * (end - a));
+}
+
+// Indices of the keys to keep: the first and the last, and every key that interpolating between the kept keys
+// around it would miss by more than tolerance. A track that never leaves its first value within tolerance keeps one key.
+template <typename Value, typename Interpolate>
+static std::vector<unsigned int> selectKeys(const std::vector<float> &times, const std::vector<Value> &values, float tolerance, Interpolate interpolate)
+{
+    const unsigned int numKeys = (unsigned int)times.size();
+    std::vector<unsigned int> kept(1, 0);
+    
+    bool constant = true;
+    for (unsigned int k = 1; k < numKeys && constant; k++) {
+        constant = maxDifference(values[k], values[0]) <= tolerance;
+    }
+    if (constant) {
+        return kept;
+    }
+    
+    // Extend the span from the last kept key as long as every key inside it can be interpolated
+    unsigned int start = 0;
+    for (unsigned int end = 2; end < numKeys; end++) {
+        const float span = times[end] - times[start];
+        for (unsigned int k = start + 1; k < end; k++) {
+            const float factor = span > 0.0f ? (times[k] - times[start]) / span : 0.0f;
+            if (maxDifference(interpolate(values[start], values[end], factor), values[k]) > tolerance) {
+                start = end - 1;
+                kept.push_back(start);
+                break;
+            }
+        }
+    }
+    kept.push_back(numKeys - 1);
+    
+    return kept;
+}
+
+
+QuantizedVectorTrack::QuantizedVectorTrack() : _min(0.0f), _step(0.0f)
+{
+}
+
+void QuantizedVectorTrack::build(const aiVectorKey* keys, unsigned int numKeys, float tolerance)
+{
+    std::vector<float> times(numKeys);
+    std::vector<glm::vec3> values(numKeys);
+    for (unsigned int k = 0; k < numKeys; k++) {
+        times[k] = (float)keys[k].mTime;
+        values[k] = glm::vec3(keys[k].mValue.x, keys[k].mValue.y, keys[k].mValue.z);
+    }
+    
+    const std::vector<unsigned int> kept = selectKeys(times, values, tolerance, lerpVector);
+    
+    glm::vec3 max = values[kept[0]];
+    _min = max;
+    for (unsigned int k : kept) {
+        _min = glm::min(_min, values[k]);
+        max = glm::max(max, values[k]);
+    }
+    _step = (max - _min) / 65535.0f;
+    
+    _times.clear();
+    _values.clear();
+    for (unsigned int k : kept) {
+        _times.push_back(times[k]);
+        for (int c = 0; c < 3; c++) {
+            const float normalized = _step[c] > 0.0f ? (values[k][c] - _min[c]) / _step[c] : 0.0f;
+            _values.push_back((uint16_t)std::min(std::max(std::round(normalized), 0.0f), 65535.0f));
+        }
+    }
+}
+
+void QuantizedVectorTrack::cook(CookedWriter &writer) const
+{
+    writer.writeArray(_times);
+    writer.writeArray(_values);
+    writer.write(_min);
+    writer.write(_step);
+}
+
+bool QuantizedVectorTrack::load(CookedReader &reader)
+{
+    reader.readArray(_times);
+    reader.readArray(_values);
+    _min = reader.read<glm::vec3>();
+    _step = reader.read<glm::vec3>();
+    return !_times.empty() && _values.size() == 3 * _times.size();
+}
+
+unsigned int QuantizedVectorTrack::getNumKeys() const
+{
+    return (unsigned int)_times.size();
+}
+
+const float* QuantizedVectorTrack::getTimes() const
+{
+    return &_times[0];
+}
+
+glm::vec3 QuantizedVectorTrack::getValue(unsigned int key) const
+{
+    const uint16_t* value = &_values[key * 3];
+    return _min + _step * glm::vec3(value[0], value[1], value[2]);
+}
+
+size_t QuantizedVectorTrack::getMemorySize() const
+{
+    return sizeof(*this) + _times.size() * sizeof(float) + _values.size() * sizeof(uint16_t);
+}
+
+
+// The three smallest components of a unit quaternion lie within +-1/sqrt(2)
+static const float SMALLEST_THREE_RANGE = 0.70710678f;
+
+void QuantizedRotationTrack::build(const aiQuatKey* keys, unsigned int numKeys, float tolerance)
+{
+    std::vector<float> times(numKeys);
+    std::vector<glm::vec4> values(numKeys);
+    for (unsigned int k = 0; k < numKeys; k++) {
+        times[k] = (float)keys[k].mTime;
+        values[k] = glm::normalize(glm::vec4(keys[k].mValue.x, keys[k].mValue.y, keys[k].mValue.z, keys[k].mValue.w));
+        // q and -q are the same rotation, keep neighbours on the same side so that they compare component-wise
+        if (k > 0 && glm::dot(values[k - 1], values[k]) < 0.0f) {
+            values[k] = -values[k];
+        }
+    }
+    
+    const std::vector<unsigned int> kept = selectKeys(times, values, tolerance, nlerpRotation);
+    
+    _times.clear();
+    _values.clear();
+    for (unsigned int k : kept) {
+        _times.push_back(times[k]);
+        
+        glm::vec4 q = values[k];
+        int largest = 0;
+        for (int c = 1; c < 4; c++) {
+            if (std::fabs(q[c]) > std::fabs(q[largest])) {
+                largest = c;
+            }
+        }
+        if (q[largest] < 0.0f) {
+            q = -q;
+        }
+        
+        uint16_t packed[3];
+        int n = 0;
+        for (int c = 0; c < 4; c++) {
+            if (c != largest) {
+                const float normalized = (q[c] / SMALLEST_THREE_RANGE * 0.5f + 0.5f) * 32767.0f;
+                packed[n++] = (uint16_t)std::min(std::max(std::round(normalized), 0.0f), 32767.0f);
+            }
+        }
+        _values.push_back(packed[0] | (uint16_t)((largest >> 1) << 15));
+        _values.push_back(packed[1] | (uint16_t)((largest & 1) << 15));
+        _values.push_back(packed[2]);
+    }
+}
+
+void QuantizedRotationTrack::cook(CookedWriter &writer) const
+{
+    writer.writeArray(_times);
+    writer.writeArray(_values);
+}
+
+bool QuantizedRotationTrack::load(CookedReader &reader)
+{
+    reader.readArray(_times);
+    reader.readArray(_values);
+    return !_times.empty() && _values.size() == 3 * _times.size();
+}
+
+unsigned int QuantizedRotationTrack::getNumKeys() const
+{
+    return (unsigned int)_times.size();
+}
+
+const float* QuantizedRotationTrack::getTimes() const
+{
+    return &_times[0];
+}
+
+glm::vec4 QuantizedRotationTrack::getValue(unsigned int key) const
+{
+    const uint16_t* value = &_values[key * 3];
+    const int largest = ((value[0] >> 15) << 1) | (value[1] >> 15);
+    
+    glm::vec4 q;
+    float sumOfSquares = 0.0f;
+    int n = 0;
+    for (int c = 0; c < 4; c++) {
+        if (c != largest) {
+            q[c] = ((value[n++] & 0x7fff) / 32767.0f * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+            sumOfSquares += q[c] * q[c];
+        }
+    }
+    q[largest] = std::sqrt(std::max(1.0f - sumOfSquares, 0.0f));
+    
+    return q;
+}
+
+size_t QuantizedRotationTrack::getMemorySize() const
+{
+    return sizeof(*this) + _times.size() * sizeof(float) + _values.size() * sizeof(uint16_t);
+}
+
+
+CompressedChannel::CompressedChannel()
+{
+}
+
+CompressedChannel::CompressedChannel(const aiNodeAnim* nodeAnim, const ClipCompressionSettings &settings)
+{
+    position.build(nodeAnim->mPositionKeys, nodeAnim->mNumPositionKeys, settings.positionTolerance);
+    rotation.build(nodeAnim->mRotationKeys, nodeAnim->mNumRotationKeys, settings.rotationTolerance);
+    scaling.build(nodeAnim->mScalingKeys, nodeAnim->mNumScalingKeys, settings.scalingTolerance);
+}
+
+void CompressedChannel::cook(CookedWriter &writer) const
+{
+    position.cook(writer);
+    rotation.cook(writer);
+    scaling.cook(writer);
+}
+
+bool CompressedChannel::load(CookedReader &reader)
+{
+    // Every track is read, so that the reader stays in step with the file
+    const bool positionValid = position.load(reader);
+    const bool rotationValid = rotation.load(reader);
+    const bool scalingValid = scaling.load(reader);
+    return positionValid && rotationValid && scalingValid;
+}
+
+size_t CompressedChannel::getMemorySize() const
+{
+    return position.getMemorySize() + rotation.getMemorySize() + scaling.getMemorySize();
+}
+
+size_t CompressedChannel::getSourceMemorySize(const aiNodeAnim* nodeAnim)
+{
+    return sizeof(aiNodeAnim) + nodeAnim->mNumPositionKeys * sizeof(aiVectorKey) + nodeAnim->mNumRotationKeys * sizeof(aiQuatKey)
+        + nodeAnim->mNumScalingKeys * sizeof(aiVectorKey);
+}
@@ -0,0 +1,98 @@
+///
+///  CompressedClip.h
+///
+///  \brief Runtime storage of animation channels. Keys that linear interpolation between their neighbours already
+///         reproduces within a tolerance are dropped, rotations are stored as their smallest three components and
+///         translations and scalings are quantized to 16 bits over the range of their track. Keys are decoded while
+///         sampling, so the Assimp scene does not need to be kept once the clips are built.
+///
+
+#ifndef CompressedClip_hpp
+#define CompressedClip_hpp
+
+#include <cstdint>
+#include <vector>
+#include <assimp/anim.h>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include "CookedAsset.h"
+
+
+// Largest difference of a component allowed when dropping a key. Quantization adds up to half a step on top of it.
+struct ClipCompressionSettings {
+    float positionTolerance = 1e-3f;    // in model units, before the load scale
+    float rotationTolerance = 5e-4f;    // per quaternion component
+    float scalingTolerance = 1e-4f;
+};
+
+// Translation or scaling keys, each component quantized to 16 bits between the smallest and largest value of the track
+class QuantizedVectorTrack
+{
+public:
+    
+    QuantizedVectorTrack();
+    
+    void build(const aiVectorKey* keys, unsigned int numKeys, float tolerance);
+    
+    // load returns false if the track read has no key or not three values per key
+    void cook(CookedWriter &writer) const;
+    bool load(CookedReader &reader);
+    
+    unsigned int getNumKeys() const;
+    const float* getTimes() const;      // in ticks, one per key
+    glm::vec3 getValue(unsigned int key) const;
+    
+    size_t getMemorySize() const;
+    
+private:
+    
+    std::vector<float> _times;
+    std::vector<uint16_t> _values;      // 3 per key
+    glm::vec3 _min;
+    glm::vec3 _step;
+};
+
+// Rotation keys in smallest three form: the largest component of the quaternion is made positive and left out, the
+// other three take 15 bits each and the index of the missing one is spread over the top bits of the first two.
+class QuantizedRotationTrack
+{
+public:
+    
+    void build(const aiQuatKey* keys, unsigned int numKeys, float tolerance);
+    
+    // load returns false if the track read has no key or not three values per key
+    void cook(CookedWriter &writer) const;
+    bool load(CookedReader &reader);
+    
+    unsigned int getNumKeys() const;
+    const float* getTimes() const;      // in ticks, one per key
+    glm::vec4 getValue(unsigned int key) const;     // x, y, z, w
+    
+    size_t getMemorySize() const;
+    
+private:
+    
+    std::vector<float> _times;
+    std::vector<uint16_t> _values;      // 3 per key
+};
+
+// Every track of one aiNodeAnim
+struct CompressedChannel {
+    QuantizedVectorTrack position;
+    QuantizedRotationTrack rotation;
+    QuantizedVectorTrack scaling;
+    
+    CompressedChannel();
+    CompressedChannel(const aiNodeAnim* nodeAnim, const ClipCompressionSettings &settings);
+    
+    // load returns false if one of the tracks read cannot be sampled
+    void cook(CookedWriter &writer) const;
+    bool load(CookedReader &reader);
+    
+    size_t getMemorySize() const;
+    
+    // Size of the keys of nodeAnim in the Assimp scene
+    static size_t getSourceMemorySize(const aiNodeAnim* nodeAnim);
+};
+
+#endif /* CompressedClip_hpp */
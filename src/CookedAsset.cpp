@@ -0,0 +1,85 @@
+//
+//  CookedAsset.cpp
+//
+
+#include "CookedAsset.h"
+
+
+bool isCookedAsset(const std::string &filename)
+{
+    const std::string extension = COOKED_ASSET_EXTENSION;
+    return filename.size() >= extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+
+CookedWriter::CookedWriter(const std::string &filename) : _file(filename.c_str(), std::ios::binary | std::ios::trunc), _offset(0)
+{
+}
+
+bool CookedWriter::isOpen() const
+{
+    return _file.is_open() && _file.good();
+}
+
+void CookedWriter::writeString(const std::string &value)
+{
+    write((uint32_t)value.size());
+    writeBytes(value.data(), value.size());
+}
+
+void CookedWriter::writeBytes(const void* bytes, size_t size)
+{
+    if (size > 0) {
+        _file.write((const char*)bytes, size);
+        _offset += size;
+    }
+}
+
+void CookedWriter::align()
+{
+    static const char padding[COOKED_ASSET_ALIGNMENT] = {};
+    writeBytes(padding, (COOKED_ASSET_ALIGNMENT - _offset % COOKED_ASSET_ALIGNMENT) % COOKED_ASSET_ALIGNMENT);
+}
+
+
+CookedReader::CookedReader(const char* data, size_t size) : _data(data), _size(size), _offset(0), _failed(false)
+{
+}
+
+bool CookedReader::hasFailed() const
+{
+    return _failed;
+}
+
+std::string CookedReader::readString()
+{
+    const uint32_t size = read<uint32_t>();
+    const char* bytes = readBytes(size);
+    return bytes != nullptr ? std::string(bytes, size) : std::string();
+}
+
+uint32_t CookedReader::readCount(size_t minItemSize)
+{
+    const uint32_t count = read<uint32_t>();
+    if (_failed || (size_t)count * minItemSize > _size - _offset) {
+        _failed = true;
+        return 0;
+    }
+    return count;
+}
+
+const char* CookedReader::readBytes(size_t size)
+{
+    if (_failed || size > _size - _offset) {
+        _failed = true;
+        return nullptr;
+    }
+    const char* bytes = _data + _offset;
+    _offset += size;
+    return bytes;
+}
+
+void CookedReader::align()
+{
+    readBytes((COOKED_ASSET_ALIGNMENT - _offset % COOKED_ASSET_ALIGNMENT) % COOKED_ASSET_ALIGNMENT);
+}
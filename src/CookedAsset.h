@@ -0,0 +1,127 @@
+///
+///  CookedAsset.h
+///
+///  \brief Binary file that a SkinnedModelData is saved to after import, so that later runs skip Assimp. Values
+///         are stored as they are laid out in memory: arrays start on a 16 byte boundary and vertex and index arrays
+///         are handed to the GPU straight from the mapped file. Files are therefore tied to the byte order and vertex
+///         layout of the build that cooked them, which the header records.
+///
+
+#ifndef CookedAsset_hpp
+#define CookedAsset_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+// Bump whenever anything written by a cook() method changes
+#define COOKED_ASSET_VERSION 5
+#define COOKED_ASSET_MAGIC "YACOOKED"
+#define COOKED_ASSET_EXTENSION ".cooked"
+#define COOKED_ASSET_ALIGNMENT 16
+
+// True if filename ends with COOKED_ASSET_EXTENSION
+bool isCookedAsset(const std::string &filename);
+
+class CookedWriter
+{
+public:
+    
+    explicit CookedWriter(const std::string &filename);
+    
+    bool isOpen() const;
+    
+    template <typename T>
+    void write(const T &value)
+    {
+        writeBytes(&value, sizeof(T));
+    }
+    
+    // Writes the count, then values from the next aligned offset
+    template <typename T>
+    void writeArray(const T* values, uint32_t count)
+    {
+        write(count);
+        align();
+        writeBytes(values, sizeof(T) * count);
+    }
+    
+    template <typename T>
+    void writeArray(const std::vector<T> &values)
+    {
+        writeArray(values.empty() ? nullptr : &values[0], (uint32_t)values.size());
+    }
+    
+    void writeString(const std::string &value);
+    
+private:
+    
+    std::ofstream _file;
+    size_t _offset;
+    
+    void writeBytes(const void* bytes, size_t size);
+    void align();
+};
+
+class CookedReader
+{
+public:
+    
+    CookedReader(const char* data, size_t size);
+    
+    // True once a read went past the end of the data. Later reads return zeros and empty arrays.
+    bool hasFailed() const;
+    
+    template <typename T>
+    T read()
+    {
+        T value = T();
+        const char* bytes = readBytes(sizeof(T));
+        if (bytes != nullptr) {
+            std::memcpy((void*)&value, bytes, sizeof(T));
+        }
+        return value;
+    }
+    
+    // Returns a pointer into the data, which must outlive it
+    template <typename T>
+    const T* readArray(uint32_t &count)
+    {
+        count = read<uint32_t>();
+        align();
+        const T* values = (const T*)readBytes(sizeof(T) * (size_t)count);
+        if (values == nullptr) {
+            count = 0;
+        }
+        return values;
+    }
+    
+    template <typename T>
+    void readArray(std::vector<T> &values)
+    {
+        uint32_t count;
+        const T* data = readArray<T>(count);
+        values.assign(data, data + count);
+    }
+    
+    std::string readString();
+    
+    // Reads the number of items that follow, each taking at least minItemSize bytes. Counts that cannot fit in the
+    // rest of the data fail the reader and return 0, so that a damaged count never allocates gigabytes.
+    uint32_t readCount(size_t minItemSize);
+    
+private:
+    
+    const char* _data;
+    size_t _size;
+    size_t _offset;
+    bool _failed;
+    
+    const char* readBytes(size_t size);
+    void align();
+};
+
+#endif /* CookedAsset_hpp */
@@ -0,0 +1,272 @@
+//
+//  FrameProfiler.cpp
+//
+
+#include "FrameProfiler.h"
+#include "GLContext.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+
+FrameProfiler::CpuScope::CpuScope(FrameProfiler &profiler, const std::string &name) :
+    _profiler(profiler), _name(name), _start(std::chrono::high_resolution_clock::now())
+{
+}
+
+FrameProfiler::CpuScope::~CpuScope()
+{
+    const std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    _profiler.addCpuTime(_name, std::chrono::duration<double, std::milli>(end - _start).count());
+}
+
+FrameProfiler::GpuScope::GpuScope(FrameProfiler &profiler, const std::string &name) : _profiler(profiler)
+{
+    _profiler.beginQuery(name);
+}
+
+FrameProfiler::GpuScope::~GpuScope()
+{
+    _profiler.endQuery();
+}
+
+FrameProfiler::FrameProfiler(int historyFrames) :
+    _historyFrames(std::max(1, historyFrames)), _frame(0), _frameOpen(false), _traceJson(false), _traceFirstRow(true)
+{
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    stopTrace();
+}
+
+void FrameProfiler::beginFrame(int frame)
+{
+    const std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+    
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_frameOpen) {
+        std::map<std::string, double> times;
+        times.swap(_cpuFrame);
+        times["frame"] = std::chrono::duration<double, std::milli>(now - _frameStart).count();
+        commit(_frame, times, false);
+    }
+    
+    _frame = frame;
+    _frameStart = now;
+    _frameOpen = true;
+}
+
+void FrameProfiler::addCpuTime(const std::string &name, double ms)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _cpuFrame[name] += ms;
+}
+
+// Only the contexts after the first one add their number to the names of their GPU timers
+FrameProfiler::ContextQueries& FrameProfiler::getContextQueries()
+{
+    const void* context = currentGLContext();
+    std::map<const void*, ContextQueries>::iterator queries = _contexts.find(context);
+    if (queries == _contexts.end()) {
+        queries = _contexts.insert(std::make_pair(context, ContextQueries())).first;
+        if (_contexts.size() > 1) {
+            queries->second.suffix = " (context " + std::to_string(_contexts.size()) + ")";
+        }
+    }
+    return queries->second;
+}
+
+void FrameProfiler::beginQuery(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ContextQueries &queries = getContextQueries();
+    assert(!queries.gpuScopeOpen);
+    
+    GLuint query = 0;
+    if (queries.freeQueries.empty()) {
+        glGenQueries(1, &query);
+    }
+    else {
+        query = queries.freeQueries.back();
+        queries.freeQueries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    queries.gpuScopeOpen = true;
+    
+    PendingQuery pending;
+    pending.query = query;
+    pending.frame = _frame;
+    pending.name = name + queries.suffix;
+    queries.pendingQueries.push_back(pending);
+}
+
+void FrameProfiler::endQuery()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ContextQueries &queries = getContextQueries();
+    assert(queries.gpuScopeOpen);
+    glEndQuery(GL_TIME_ELAPSED);
+    queries.gpuScopeOpen = false;
+}
+
+// Reads the queries that finished, oldest first. A frame's GPU timers are committed once a query of a later frame
+// has finished, or no query is left, so that passes run several times in a frame are summed.
+void FrameProfiler::readGpuTimers()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    ContextQueries &queries = getContextQueries();
+    assert(!queries.gpuScopeOpen);
+    
+    std::deque<PendingQuery> &pendingQueries = queries.pendingQueries;
+    std::map<std::string, double> &gpuFrameTimes = queries.gpuFrameTimes;
+    while (!pendingQueries.empty()) {
+        const PendingQuery &pending = pendingQueries.front();
+        GLint available = 0;
+        glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &nanoseconds);
+        
+        if (pending.frame != queries.gpuFrame && !gpuFrameTimes.empty()) {
+            commit(queries.gpuFrame, gpuFrameTimes, true);
+            gpuFrameTimes.clear();
+        }
+        queries.gpuFrame = pending.frame;
+        gpuFrameTimes[pending.name] += nanoseconds / 1.0e6;
+        
+        queries.freeQueries.push_back(pending.query);
+        pendingQueries.pop_front();
+    }
+    if (pendingQueries.empty() && !gpuFrameTimes.empty()) {
+        commit(queries.gpuFrame, gpuFrameTimes, true);
+        gpuFrameTimes.clear();
+    }
+}
+
+void FrameProfiler::commit(int frame, const std::map<std::string, double> &times, bool gpu)
+{
+    std::map<std::string, History> &histories = gpu ? _gpuHistory : _cpuHistory;
+    std::vector<std::string> &order = gpu ? _gpuOrder : _cpuOrder;
+    for (const std::pair<const std::string, double> &time : times) {
+        if (histories.count(time.first) == 0) {
+            order.push_back(time.first);
+        }
+        addValue(histories[time.first], (float)time.second, _historyFrames);
+        writeTraceRow(frame, (gpu ? "gpu " : "cpu ") + time.first, time.second);
+    }
+}
+
+void FrameProfiler::addValue(History &history, float value, int historyFrames)
+{
+    if (history.values.size() < (size_t)historyFrames) {
+        history.values.resize(historyFrames);
+    }
+    history.values[history.next] = value;
+    history.next = (history.next + 1) % historyFrames;
+    history.count = std::min(history.count + 1, historyFrames);
+}
+
+FrameProfiler::Stats FrameProfiler::computeStats(const History &history)
+{
+    Stats stats;
+    if (history.count == 0) {
+        return stats;
+    }
+    const int size = (int)history.values.size();
+    stats.last = history.values[(history.next + size - 1) % size];
+    stats.min = stats.max = stats.last;
+    double sum = 0.0;
+    for (int i = 0; i < history.count; i++) {
+        const float value = history.values[(history.next + size - 1 - i) % size];
+        stats.min = std::min(stats.min, value);
+        stats.max = std::max(stats.max, value);
+        sum += value;
+    }
+    stats.mean = (float)(sum / history.count);
+    stats.numFrames = history.count;
+    return stats;
+}
+
+std::vector<std::string> FrameProfiler::getCpuTimers() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _cpuOrder;
+}
+
+std::vector<std::string> FrameProfiler::getGpuTimers() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _gpuOrder;
+}
+
+FrameProfiler::Stats FrameProfiler::getCpuStats(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<std::string, History>::const_iterator history = _cpuHistory.find(name);
+    return history != _cpuHistory.end() ? computeStats(history->second) : Stats();
+}
+
+FrameProfiler::Stats FrameProfiler::getGpuStats(const std::string &name) const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::map<std::string, History>::const_iterator history = _gpuHistory.find(name);
+    return history != _gpuHistory.end() ? computeStats(history->second) : Stats();
+}
+
+bool FrameProfiler::startTrace(const std::string &filename)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    closeTrace();
+    
+    _trace.open(filename.c_str());
+    if (!_trace) {
+        std::cout << "Could not open trace file " << filename << std::endl;
+        return false;
+    }
+    const std::string extension = ".json";
+    _traceJson = filename.size() >= extension.size() && filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0;
+    _traceFirstRow = true;
+    _trace << (_traceJson ? "[" : "frame,timer,ms") << "\n";
+    return true;
+}
+
+void FrameProfiler::stopTrace()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    closeTrace();
+}
+
+void FrameProfiler::closeTrace()
+{
+    if (!_trace.is_open()) {
+        return;
+    }
+    if (_traceJson) {
+        _trace << "\n]\n";
+    }
+    _trace.close();
+}
+
+bool FrameProfiler::isTracing() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _trace.is_open();
+}
+
+void FrameProfiler::writeTraceRow(int frame, const std::string &timer, double ms)
+{
+    if (!_trace.is_open()) {
+        return;
+    }
+    if (_traceJson) {
+        _trace << (_traceFirstRow ? "" : ",\n") << "{\"frame\": " << frame << ", \"timer\": \"" << timer << "\", \"ms\": " << ms << "}";
+    }
+    else {
+        _trace << frame << "," << timer << "," << ms << "\n";
+    }
+    _traceFirstRow = false;
+}
@@ -0,0 +1,172 @@
+///
+///  FrameProfiler.h
+///
+///  \brief Times the stages of each frame: CPU scopes with the high resolution clock and GPU passes with
+///         GL_TIME_ELAPSED queries, which are read back a few frames later so that the CPU never waits on the GPU.
+///         Every timer keeps rolling statistics over the last frames for ProfilerOverlay, and the timings of every
+///         frame can be written to a CSV or JSON trace for offline analysis. Queries belong to the GL context that
+///         issued them, so each context keeps its own and reads them back itself.
+///
+
+#ifndef FrameProfiler_hpp
+#define FrameProfiler_hpp
+
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include "GL/glew.h"
+#include "GL/wglew.h"
+#elif (!defined(__APPLE__))
+#include "GL/glxew.h"
+#endif
+
+// OpenGL Headers
+#if defined(WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <GL/gl.h>
+#elif defined(__APPLE__)
+#define GL_GLEXT_PROTOTYPES
+#include <OpenGL/gl3.h>
+#include <OpenGL/glext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+
+class FrameProfiler
+{
+public:
+    
+    // Rolling statistics of a timer over the last frames it ran in, in milliseconds. A timer that runs several times
+    // in a frame, once per eye for instance, counts the sum.
+    struct Stats {
+        float last = 0.0f;
+        float mean = 0.0f;
+        float min = 0.0f;
+        float max = 0.0f;
+        int numFrames = 0;
+    };
+    
+    // Adds the time until it goes out of scope to the CPU timer name of the current frame
+    class CpuScope
+    {
+    public:
+        CpuScope(FrameProfiler &profiler, const std::string &name);
+        ~CpuScope();
+    private:
+        FrameProfiler &_profiler;
+        std::string _name;
+        std::chrono::high_resolution_clock::time_point _start;
+    };
+    
+    // Measures the GPU time of the commands issued until it goes out of scope into the GPU timer name. GPU scopes
+    // cannot nest, GL only runs one GL_TIME_ELAPSED query at a time. Contexts after the first one time their passes
+    // into timers named after the context, "draw (context 2)" for instance.
+    class GpuScope
+    {
+    public:
+        GpuScope(FrameProfiler &profiler, const std::string &name);
+        ~GpuScope();
+    private:
+        FrameProfiler &_profiler;
+    };
+    
+    // Statistics cover the last historyFrames frames
+    explicit FrameProfiler(int historyFrames = 120);
+    
+    // Leaves the queries to their contexts, which delete them with everything else they own
+    ~FrameProfiler();
+    
+    // Closes the previous frame, adding its duration to the "frame" timer. Call once per frame before any scope.
+    void beginFrame(int frame);
+    
+    // Collects the GPU timings of the current context that are ready. Call once per frame with every context that
+    // uses GPU scopes, outside of them.
+    void readGpuTimers();
+    
+    // Adds ms to the CPU timer name of the current frame, for stages timed elsewhere such as on a loader thread or by
+    // several contexts. Can be called from any thread, like everything but the GPU scopes and readGpuTimers, which
+    // need their context current.
+    void addCpuTime(const std::string &name, double ms);
+    
+    // Names of the timers seen so far, CPU ones first, each in the order they first ran
+    std::vector<std::string> getCpuTimers() const;
+    std::vector<std::string> getGpuTimers() const;
+    Stats getCpuStats(const std::string &name) const;
+    Stats getGpuStats(const std::string &name) const;
+    
+    // Writes the timings of every frame to filename until stopTrace, one row per frame and timer. Files ending in
+    // .json get a JSON array of {"frame", "timer", "ms"} objects, others comma separated values with a header.
+    // GPU rows follow the CPU rows of later frames, once their queries are read.
+    bool startTrace(const std::string &filename);
+    void stopTrace();
+    bool isTracing() const;
+
+private:
+    
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+    
+    // Last historyFrames values of a timer, oldest overwritten first
+    struct History {
+        std::vector<float> values;
+        int next = 0;
+        int count = 0;
+    };
+    
+    struct PendingQuery {
+        GLuint query;
+        int frame;
+        std::string name;
+    };
+    
+    // Queries of one context
+    struct ContextQueries {
+        std::string suffix;                     // of its GPU timers
+        std::vector<GLuint> freeQueries;
+        std::deque<PendingQuery> pendingQueries;    // in the order they were issued
+        bool gpuScopeOpen = false;
+        int gpuFrame = -1;                      // frame the results in gpuFrameTimes belong to
+        std::map<std::string, double> gpuFrameTimes;
+    };
+    
+    int _historyFrames;
+    
+    mutable std::mutex _mutex;                  // guards everything below
+    int _frame;
+    bool _frameOpen;
+    std::chrono::high_resolution_clock::time_point _frameStart;
+    std::map<std::string, double> _cpuFrame;    // timers of the current frame
+    
+    std::map<std::string, History> _cpuHistory;
+    std::map<std::string, History> _gpuHistory;
+    std::vector<std::string> _cpuOrder;
+    std::vector<std::string> _gpuOrder;
+    
+    std::map<const void*, ContextQueries> _contexts;    // by currentGLContext()
+    
+    std::ofstream _trace;
+    bool _traceJson;
+    bool _traceFirstRow;
+    
+    // Must hold _mutex
+    ContextQueries& getContextQueries();
+    void beginQuery(const std::string &name);
+    void endQuery();
+    void commit(int frame, const std::map<std::string, double> &times, bool gpu);
+    void writeTraceRow(int frame, const std::string &timer, double ms);
+    void closeTrace();
+    
+    static void addValue(History &history, float value, int historyFrames);
+    static Stats computeStats(const History &history);
+};
+
+#endif /* FrameProfiler_hpp */
@@ -0,0 +1,26 @@
+//
+//  GLContext.cpp
+//
+
+#include "GLContext.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <OpenGL/OpenGL.h>
+#else
+#include "GL/glxew.h"
+#endif
+
+
+const void* currentGLContext()
+{
+#if defined(_WIN32)
+    return wglGetCurrentContext();
+#elif defined(__APPLE__)
+    return CGLGetCurrentContext();
+#else
+    return glXGetCurrentContext();
+#endif
+}
@@ -0,0 +1,15 @@
+///
+///  GLContext.h
+///
+///  \brief Identifies the GL context current on the calling thread. VAOs and queries never leave the context that
+///         created them, and buffers, textures and programs only do when contexts share them, so everything drawn
+///         by several contexts, one per window of a MinVR setup, is kept per context under this key.
+///
+
+#ifndef GLContext_hpp
+#define GLContext_hpp
+
+// Null when no context is current
+const void* currentGLContext();
+
+#endif /* GLContext_hpp */
@@ -0,0 +1,132 @@
+//
+//  JobSystem.cpp
+//
+
+#include "JobSystem.h"
+
+#include <algorithm>
+
+
+JobSystem::JobSystem(int numThreads) : _generation(0), _quit(false), _job(nullptr), _remaining(0)
+{
+    if (numThreads <= 0) {
+        numThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    }
+    
+    for (int i = 0; i < numThreads; i++) {
+        _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 1; i < numThreads; i++) {
+        _workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _quit = true;
+    }
+    _wake.notify_all();
+    
+    for (int i = 0; i < _workers.size(); i++) {
+        _workers[i].join();
+    }
+}
+
+int JobSystem::getNumThreads() const
+{
+    return (int)_queues.size();
+}
+
+void JobSystem::parallelFor(int count, int grainSize, const std::function<void(int, int)> &job)
+{
+    if (count <= 0) {
+        return;
+    }
+    grainSize = std::max(grainSize, 1);
+    
+    const int numRanges = (count + grainSize - 1) / grainSize;
+    if (numRanges == 1 || _workers.empty()) {
+        job(0, count);
+        return;
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _remaining = numRanges;
+        
+        // Deal the ranges out in contiguous blocks, so that each thread starts on its own part of the data
+        const int numThreads = getNumThreads();
+        for (int r = 0; r < numRanges; r++) {
+            Range range;
+            range.begin = r * grainSize;
+            range.end = std::min(count, range.begin + grainSize);
+            
+            Queue &queue = *_queues[(long long)r * numThreads / numRanges];
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.ranges.push_back(range);
+        }
+        _generation++;
+    }
+    _wake.notify_all();
+    
+    runRanges(0);
+    
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this]() { return _remaining == 0; });
+    _job = nullptr;
+}
+
+// Takes the next range of the thread's own queue, or steals the last range of another queue
+bool JobSystem::popRange(int thread, Range &range)
+{
+    const int numThreads = getNumThreads();
+    for (int i = 0; i < numThreads; i++) {
+        Queue &queue = *_queues[(thread + i) % numThreads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.ranges.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            range = queue.ranges.front();
+            queue.ranges.pop_front();
+        }
+        else {
+            range = queue.ranges.back();
+            queue.ranges.pop_back();
+        }
+        return true;
+    }
+    return false;
+}
+
+void JobSystem::runRanges(int thread)
+{
+    Range range;
+    while (popRange(thread, range)) {
+        (*_job)(range.begin, range.end);
+        
+        if (--_remaining == 0) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done.notify_all();
+        }
+    }
+}
+
+void JobSystem::workerLoop(int thread)
+{
+    unsigned int generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this, generation]() { return _quit || _generation != generation; });
+            if (_quit) {
+                return;
+            }
+            generation = _generation;
+        }
+        runRanges(thread);
+    }
+}
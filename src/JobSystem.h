@@ -0,0 +1,68 @@
+///
+///  JobSystem.h
+///
+///  \brief Small work-stealing thread pool. Work is split into ranges that are queued on every thread; a thread that
+///         runs out of ranges steals from the others. The calling thread works too, and parallelFor only returns
+///         once every range has run, so it is also the barrier before the results are used.
+///
+
+#ifndef JobSystem_hpp
+#define JobSystem_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+class JobSystem
+{
+public:
+    
+    // numThreads includes the calling thread. 0 uses one thread per hardware core.
+    explicit JobSystem(int numThreads = 0);
+    ~JobSystem();
+    
+    int getNumThreads() const;
+    
+    // Calls job(begin, end) on ranges of at most grainSize items covering [0, count), from any thread.
+    // Ranges must not depend on each other.
+    void parallelFor(int count, int grainSize, const std::function<void(int, int)> &job);
+    
+private:
+    
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    
+    struct Range {
+        int begin;
+        int end;
+    };
+    
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+    
+    std::vector<std::thread> _workers;
+    std::vector<std::unique_ptr<Queue> > _queues;   // one per thread, 0 is the thread calling parallelFor
+    
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    unsigned int _generation;                       // incremented by every parallelFor, wakes the workers
+    bool _quit;
+    
+    const std::function<void(int, int)>* _job;
+    std::atomic<int> _remaining;
+    
+    bool popRange(int thread, Range &range);
+    void runRanges(int thread);
+    void workerLoop(int thread);
+};
+
+#endif /* JobSystem_hpp */
@@ -0,0 +1,74 @@
+///
+///  KeyframeSearch.h
+///
+///  \brief Locates the keyframe interval containing an animation time. Works on any key type with an mTime member
+///         (aiVectorKey, aiQuatKey) and on plain arrays of float times. The cursor variant remembers the last interval, so that playing a clip forward
+///         usually finds the next key in one or two compares instead of a search.
+///
+
+#ifndef KeyframeSearch_hpp
+#define KeyframeSearch_hpp
+
+#include <algorithm>
+#include <cassert>
+
+template <typename Key>
+inline float keyTime(const Key &key)
+{
+    return (float)key.mTime;
+}
+
+inline float keyTime(float time)
+{
+    return time;
+}
+
+template <typename Key>
+inline bool keyTimeLess(float time, const Key &key)
+{
+    return time < keyTime(key);
+}
+
+// Binary search for the interval containing AnimationTime, among the intervals starting at keys[first, last - 1).
+template <typename Key>
+inline unsigned int findKeyInRange(float AnimationTime, const Key* keys, unsigned int first, unsigned int last)
+{
+    const Key* next = std::upper_bound(keys + first + 1, keys + last, AnimationTime, keyTimeLess<Key>);
+    const unsigned int index = (unsigned int)(next - keys) - 1;
+    return std::min(index, last - 2);
+}
+
+// Returns the index i of the first key such that AnimationTime falls before keys[i + 1], clamped to [0, numKeys - 2].
+template <typename Key>
+inline unsigned int findKey(float AnimationTime, const Key* keys, unsigned int numKeys)
+{
+    assert(numKeys > 1);
+    return findKeyInRange(AnimationTime, keys, 0, numKeys);
+}
+
+// Same result as findKey, starting from the interval found by the previous call. cursor is updated with the result.
+template <typename Key>
+inline unsigned int findKey(float AnimationTime, const Key* keys, unsigned int numKeys, unsigned int &cursor)
+{
+    assert(numKeys > 1);
+    
+    unsigned int index = cursor;
+    if (index > numKeys - 2 || (index > 0 && AnimationTime < keyTime(keys[index]))) {
+        // Playback looped or jumped backwards
+        index = findKeyInRange(AnimationTime, keys, 0, std::min(index + 1, numKeys));
+    }
+    else if (index < numKeys - 2 && AnimationTime >= keyTime(keys[index + 1])) {
+        // Moved forward, almost always into the very next interval
+        if (index + 2 < numKeys - 1 && AnimationTime >= keyTime(keys[index + 2])) {
+            index = findKeyInRange(AnimationTime, keys, index + 2, numKeys);
+        }
+        else {
+            index = index + 1;
+        }
+    }
+    
+    cursor = index;
+    return index;
+}
+
+#endif /* KeyframeSearch_hpp */
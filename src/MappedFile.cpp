@@ -0,0 +1,100 @@
+//
+//  MappedFile.cpp
+//
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &filename) : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+{
+    _file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (_file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(_file, &size) || size.QuadPart == 0) {
+        return;
+    }
+    
+    _mapping = CreateFileMappingA(_file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (_mapping == nullptr) {
+        return;
+    }
+    
+    _data = (const char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (_data != nullptr) {
+        _size = (size_t)size.QuadPart;
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data != nullptr) {
+        UnmapViewOfFile(_data);
+    }
+    if (_mapping != nullptr) {
+        CloseHandle(_mapping);
+    }
+    if (_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(_file);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &filename) : _data(nullptr), _size(0)
+{
+    const int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+        return;
+    }
+    
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0) {
+        void* data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            _data = (const char*)data;
+            _size = (size_t)status.st_size;
+        }
+    }
+    
+    // The mapping stays valid without the descriptor
+    close(file);
+}
+
+MappedFile::~MappedFile()
+{
+    if (_data != nullptr) {
+        munmap((void*)_data, _size);
+    }
+}
+
+#endif
+
+bool MappedFile::isOpen() const
+{
+    return _data != nullptr;
+}
+
+const char* MappedFile::getData() const
+{
+    return _data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return _size;
+}
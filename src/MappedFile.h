@@ -0,0 +1,41 @@
+///
+///  MappedFile.h
+///
+///  \brief Read-only view of a whole file mapped into memory. Pages are only read from disk when they are touched,
+///         and nothing is copied into the process until then.
+///
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <cstddef>
+#include <string>
+
+
+class MappedFile
+{
+public:
+    
+    // Maps filename. isOpen() is false if the file does not exist or cannot be mapped.
+    explicit MappedFile(const std::string &filename);
+    ~MappedFile();
+    
+    bool isOpen() const;
+    const char* getData() const;
+    size_t getSize() const;
+    
+private:
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    const char* _data;
+    size_t _size;
+    
+#ifdef _WIN32
+    void* _file;
+    void* _mapping;
+#endif
+};
+
+#endif /* MappedFile_hpp */
@@ -0,0 +1,206 @@
+//
+//  MeshBuffers.cpp
+//
+
+#include "MeshBuffers.h"
+
+#include <cassert>
+
+
+MeshBuffers::MeshBuffers(const BoneMesh::VertexFormat &format, GLenum indexType, GLenum usage, int numVertices, int numIndices, bool centersOfRotation) :
+    _format(format), _indexType(indexType), _centerVBO(0), _indirectBuffer(0), _numVertices(0), _numIndices(0), _allocatedVertices(numVertices),
+    _allocatedIndices(numIndices), _commandsChanged(false)
+{
+    glGenVertexArrays(1, &_vaoID);
+    glBindVertexArray(_vaoID);
+    
+    glGenBuffers(1, &_vertexVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexVBO);
+    glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)format.getStride() * numVertices, NULL, usage);
+    BoneMesh::setAttributes(format);
+    
+    if (centersOfRotation) {
+        // Meshes without centers leave zeros, they are drawn with linear blend skinning and never read them
+        std::vector<glm::vec3> zeros(numVertices, glm::vec3(0.0f));
+        glGenBuffers(1, &_centerVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, _centerVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * numVertices, zeros.empty() ? NULL : &zeros[0], usage);
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+    }
+    
+    glGenBuffers(1, &_indexVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexVBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)getIndexSize() * numIndices, NULL, usage);
+    
+    glBindVertexArray(0);
+    
+    if (hasMultiDrawIndirect()) {
+        glGenBuffers(1, &_indirectBuffer);
+    }
+}
+
+MeshBuffers::~MeshBuffers()
+{
+    //Assumes object is deleted with the correct context current
+    glDeleteBuffers(1, &_vertexVBO);
+    glDeleteBuffers(1, &_indexVBO);
+    if (_centerVBO != 0) {
+        glDeleteBuffers(1, &_centerVBO);
+    }
+    if (_indirectBuffer != 0) {
+        glDeleteBuffers(1, &_indirectBuffer);
+    }
+    glDeleteVertexArrays(1, &_vaoID);
+}
+
+MeshBuffers::Allocation MeshBuffers::add(const void* vertices, int numVertices, const int* indices, int numIndices, const glm::vec3* centers)
+{
+    assert(_numVertices + numVertices <= _allocatedVertices);
+    assert(_numIndices + numIndices <= _allocatedIndices);
+    
+    Allocation allocation = { _numVertices, _numIndices };
+    
+    const int stride = _format.getStride();
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexVBO);
+    if (numVertices > 0 && vertices != nullptr) {
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)stride * _numVertices, (GLsizeiptr)stride * numVertices, vertices);
+    }
+    if (_centerVBO != 0 && numVertices > 0 && centers != nullptr) {
+        glBindBuffer(GL_ARRAY_BUFFER, _centerVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * _numVertices, sizeof(glm::vec3) * numVertices, centers);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    
+    assert(_indexType != GL_UNSIGNED_SHORT || numVertices <= 65536);
+    _numVertices += numVertices;
+    addIndices(indices, numIndices);
+    
+    return allocation;
+}
+
+int MeshBuffers::addIndices(const int* indices, int numIndices)
+{
+    assert(_numIndices + numIndices <= _allocatedIndices);
+    
+    const int first = _numIndices;
+    // The element buffer binding belongs to the VAO
+    if (numIndices > 0 && indices != nullptr) {
+        const int indexSize = getIndexSize();
+        std::vector<GLushort> shortIndices;
+        const void* data = indices;
+        if (_indexType == GL_UNSIGNED_SHORT) {
+            shortIndices.assign(indices, indices + numIndices);
+            data = &shortIndices[0];
+        }
+        glBindVertexArray(_vaoID);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, (GLintptr)indexSize * _numIndices, (GLsizeiptr)indexSize * numIndices, data);
+        glBindVertexArray(0);
+    }
+    _numIndices += numIndices;
+    
+    return first;
+}
+
+int MeshBuffers::addCommands(const std::vector<DrawCommand> &commands)
+{
+    const int first = (int)_commands.size();
+    for (const DrawCommand &command : commands) {
+        _commands.push_back(command);
+        _counts.push_back((GLsizei)command.count);
+        _indexOffsets.push_back((const void*)((size_t)getIndexSize() * command.firstIndex));
+        _baseVertices.push_back(command.baseVertex);
+    }
+    _commandsChanged = true;
+    return first;
+}
+
+void MeshBuffers::draw(GLenum primitiveType, int firstCommand, int numCommands, int numInstances)
+{
+    glBindVertexArray(_vaoID);
+    submit(primitiveType, firstCommand, numCommands, numInstances);
+    glBindVertexArray(0);
+}
+
+void MeshBuffers::submit(GLenum primitiveType, int firstCommand, int numCommands, int numInstances)
+{
+    assert(firstCommand >= 0 && firstCommand + numCommands <= (int)_commands.size());
+    if (numCommands <= 0 || numInstances <= 0) {
+        return;
+    }
+    
+#ifndef __APPLE__
+    if (_indirectBuffer != 0) {
+        // A batch is usually drawn with the same number of instances as before, then nothing is uploaded
+        bool countsChanged = false;
+        for (int c = firstCommand; c < firstCommand + numCommands; c++) {
+            if (_commands[c].instanceCount != (GLuint)numInstances) {
+                _commands[c].instanceCount = (GLuint)numInstances;
+                countsChanged = true;
+            }
+        }
+        
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirectBuffer);
+        if (_commandsChanged) {
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawCommand) * _commands.size(), &_commands[0], GL_DYNAMIC_DRAW);
+            _commandsChanged = false;
+        }
+        else if (countsChanged) {
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, (GLintptr)(sizeof(DrawCommand) * firstCommand), (GLsizeiptr)(sizeof(DrawCommand) * numCommands),
+                            &_commands[firstCommand]);
+        }
+        glMultiDrawElementsIndirect(primitiveType, _indexType, (const void*)(sizeof(DrawCommand) * (size_t)firstCommand), numCommands, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        return;
+    }
+#endif
+    
+    if (numInstances > 1) {
+        for (int c = firstCommand; c < firstCommand + numCommands; c++) {
+            glDrawElementsInstancedBaseVertex(primitiveType, _counts[c], _indexType, _indexOffsets[c], numInstances, _baseVertices[c]);
+        }
+    }
+    else {
+        glMultiDrawElementsBaseVertex(primitiveType, &_counts[firstCommand], _indexType, (const GLvoid* const*)&_indexOffsets[firstCommand],
+                                      numCommands, &_baseVertices[firstCommand]);
+    }
+}
+
+const BoneMesh::VertexFormat& MeshBuffers::getVertexFormat() const
+{
+    return _format;
+}
+
+GLenum MeshBuffers::getIndexType() const
+{
+    return _indexType;
+}
+
+int MeshBuffers::getIndexSize() const
+{
+    return _indexType == GL_UNSIGNED_SHORT ? (int)sizeof(GLushort) : (int)sizeof(GLuint);
+}
+
+bool MeshBuffers::hasCentersOfRotation() const
+{
+    return _centerVBO != 0;
+}
+
+GLuint MeshBuffers::getVAOID() const
+{
+    return _vaoID;
+}
+
+GLenum MeshBuffers::getIndexType(int numVertices)
+{
+    return numVertices <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+bool MeshBuffers::hasMultiDrawIndirect()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+#endif
+}
@@ -0,0 +1,102 @@
+///
+///  MeshBuffers.h
+///
+///  \brief One vertex buffer, index buffer and VAO shared by all the meshes of a model that have the same vertex
+///         format. Each mesh gets a base vertex and a first index in them, so the draws of many submeshes only bind
+///         one VAO, and draws that also share a material and shader variant are submitted as a single
+///         glMultiDrawElementsIndirect, or glMultiDrawElementsBaseVertex where indirect draws are not supported.
+///         Indices are relative to the base vertex of their mesh, so they are stored in 16 bits whenever every mesh
+///         in the buffers has at most 65536 vertices.
+///
+
+#ifndef MeshBuffers_hpp
+#define MeshBuffers_hpp
+
+#include <vector>
+#include "BoneMesh.h"
+
+
+class MeshBuffers
+{
+public:
+    
+    // Where a mesh was put in the buffers
+    struct Allocation {
+        int baseVertex;
+        int firstIndex;
+    };
+    
+    // Laid out as GL reads indirect draws. firstIndex and baseVertex already include the allocation of the mesh, and
+    // instanceCount is that of the last draw of the command.
+    struct DrawCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+    
+    // Needs a current GL context. Allocates room for numVertices vertices in format and numIndices indices of
+    // indexType, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, and for a center of rotation per vertex if centersOfRotation.
+    MeshBuffers(const BoneMesh::VertexFormat &format, GLenum indexType, GLenum usage, int numVertices, int numIndices, bool centersOfRotation);
+    ~MeshBuffers();
+    
+    // Uploads a mesh after the ones added before it. vertices are in the format of the buffers, indices start at 0
+    // for the first of them and are narrowed to the index type. centers can be null, even if the buffers have room
+    // for them.
+    Allocation add(const void* vertices, int numVertices, const int* indices, int numIndices, const glm::vec3* centers = nullptr);
+    
+    // Uploads more indices into vertices added before, like those of a level of detail, and returns the first
+    int addIndices(const int* indices, int numIndices);
+    
+    // Appends commands that are drawn together, and returns the index of the first. The commands are uploaded on
+    // the first draw after they change.
+    int addCommands(const std::vector<DrawCommand> &commands);
+    
+    // Binds the VAO and draws numInstances instances of numCommands commands from firstCommand with the current
+    // program, in a single glMultiDrawElementsIndirect. Without indirect draws, several instances take an instanced
+    // draw per command.
+    void draw(GLenum primitiveType, int firstCommand, int numCommands, int numInstances = 1);
+    // Same, with the VAO already bound
+    void submit(GLenum primitiveType, int firstCommand, int numCommands, int numInstances = 1);
+    
+    const BoneMesh::VertexFormat& getVertexFormat() const;
+    GLenum getIndexType() const;
+    int getIndexSize() const;
+    bool hasCentersOfRotation() const;
+    GLuint getVAOID() const;
+    
+    // Smallest index type for a mesh of numVertices vertices
+    static GLenum getIndexType(int numVertices);
+    
+    // True if the context has glMultiDrawElementsIndirect (GL 4.3 or ARB_multi_draw_indirect)
+    static bool hasMultiDrawIndirect();
+
+private:
+    
+    MeshBuffers(const MeshBuffers&) = delete;
+    MeshBuffers& operator=(const MeshBuffers&) = delete;
+    
+    BoneMesh::VertexFormat _format;
+    GLenum _indexType;
+    GLuint _vaoID;
+    GLuint _vertexVBO;
+    GLuint _indexVBO;
+    GLuint _centerVBO;                  // 0 without centers of rotation
+    GLuint _indirectBuffer;             // 0 without multi draw indirect
+    
+    int _numVertices;
+    int _numIndices;
+    int _allocatedVertices;
+    int _allocatedIndices;
+    
+    std::vector<DrawCommand> _commands;
+    bool _commandsChanged;              // all of them are uploaded again
+    
+    // The commands as glMultiDrawElementsBaseVertex takes them
+    std::vector<GLsizei> _counts;
+    std::vector<const void*> _indexOffsets;
+    std::vector<GLint> _baseVertices;
+};
+
+#endif /* MeshBuffers_hpp */
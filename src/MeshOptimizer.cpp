@@ -0,0 +1,475 @@
+//
+//  MeshOptimizer.cpp
+//
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+
+// Vertices are compared and hashed as bytes, SkinnedVertex has no padding
+struct VertexHash {
+    size_t operator()(const SkinnedVertex* vertex) const
+    {
+        const unsigned char* bytes = (const unsigned char*)vertex;
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < sizeof(SkinnedVertex); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        }
+        return (size_t)hash;
+    }
+};
+
+struct VertexEqual {
+    bool operator()(const SkinnedVertex* a, const SkinnedVertex* b) const
+    {
+        return std::memcmp(a, b, sizeof(SkinnedVertex)) == 0;
+    }
+};
+
+int weldVertices(std::vector<SkinnedVertex> &vertices, std::vector<int> &indices)
+{
+    static_assert(sizeof(SkinnedVertex) == sizeof(float) * 8 + (sizeof(uint) + sizeof(float)) * NUM_BONES_PER_VERTEX,
+                  "Vertices are compared as bytes and must not have padding");
+    
+    std::unordered_map<const SkinnedVertex*, int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    std::vector<int> remap(vertices.size());
+    std::vector<SkinnedVertex> welded;
+    welded.reserve(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) {
+        // Keys point into vertices, which is left untouched until the end
+        auto inserted = unique.insert(std::make_pair(&vertices[v], (int)welded.size()));
+        if (inserted.second) {
+            welded.push_back(vertices[v]);
+        }
+        remap[v] = inserted.first->second;
+    }
+    
+    for (int &index : indices) {
+        index = remap[index];
+    }
+    vertices.swap(welded);
+    return (int)vertices.size();
+}
+
+// Score of a vertex from its position in the cache, -1 if it is not in it, and the number of triangles not yet
+// emitted that use it. Recently used vertices score high, the last three least since their triangle was just drawn,
+// and vertices with few triangles left get a boost so that they are finished instead of left stranded.
+static float vertexScore(int cachePosition, int numTrianglesLeft)
+{
+    if (numTrianglesLeft == 0) {
+        return -1.0f;
+    }
+    
+    float score = 0.0f;
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            score = 0.75f;
+        }
+        else {
+            const float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = std::pow(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+    return score + 2.0f / std::sqrt((float)numTrianglesLeft);
+}
+
+void optimizeVertexCache(int* indices, int numIndices, int numVertices)
+{
+    const int numTriangles = numIndices / 3;
+    if (numTriangles < 2) {
+        return;
+    }
+    
+    // Triangles of every vertex, those of vertex v from triangleOffsets[v]
+    std::vector<int> numTrianglesLeft(numVertices, 0);
+    for (int i = 0; i < numTriangles * 3; i++) {
+        numTrianglesLeft[indices[i]]++;
+    }
+    std::vector<int> triangleOffsets(numVertices + 1, 0);
+    for (int v = 0; v < numVertices; v++) {
+        triangleOffsets[v + 1] = triangleOffsets[v] + numTrianglesLeft[v];
+    }
+    std::vector<int> vertexTriangles(triangleOffsets[numVertices]);
+    std::vector<int> filled(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (int t = 0; t < numTriangles; t++) {
+        for (int k = 0; k < 3; k++) {
+            vertexTriangles[filled[indices[3 * t + k]]++] = t;
+        }
+    }
+    
+    std::vector<float> vertexScores(numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        vertexScores[v] = vertexScore(-1, numTrianglesLeft[v]);
+    }
+    std::vector<bool> emitted(numTriangles, false);
+    
+    std::vector<int> cache;
+    cache.reserve(VERTEX_CACHE_SIZE + 3);
+    std::vector<int> optimized;
+    optimized.reserve(numTriangles * 3);
+    
+    // Start with the triangle whose vertices have the fewest other triangles, on the border of the mesh
+    int bestTriangle = 0;
+    float bestStartScore = -1.0f;
+    for (int t = 0; t < numTriangles; t++) {
+        const float score = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+        if (score > bestStartScore) {
+            bestStartScore = score;
+            bestTriangle = t;
+        }
+    }
+    int nextUnemitted = 0;
+    while (bestTriangle >= 0) {
+        emitted[bestTriangle] = true;
+        
+        // The vertices of the triangle move to the front of the cache, the others are pushed back
+        std::vector<int> newCache;
+        newCache.reserve(VERTEX_CACHE_SIZE + 3);
+        for (int k = 0; k < 3; k++) {
+            const int v = indices[3 * bestTriangle + k];
+            optimized.push_back(v);
+            newCache.push_back(v);
+            
+            // Remove the triangle from those left for the vertex
+            int* first = &vertexTriangles[triangleOffsets[v]];
+            int* last = first + numTrianglesLeft[v];
+            std::iter_swap(std::find(first, last, bestTriangle), last - 1);
+            numTrianglesLeft[v]--;
+        }
+        for (int v : cache) {
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                newCache.push_back(v);
+            }
+        }
+        // Vertices pushed out of the cache lose their position
+        for (int i = VERTEX_CACHE_SIZE; i < newCache.size(); i++) {
+            vertexScores[newCache[i]] = vertexScore(-1, numTrianglesLeft[newCache[i]]);
+        }
+        if (newCache.size() > VERTEX_CACHE_SIZE) {
+            newCache.resize(VERTEX_CACHE_SIZE);
+        }
+        cache.swap(newCache);
+        
+        // Only the triangles of cached vertices change score, the best of them is drawn next
+        for (int i = 0; i < cache.size(); i++) {
+            vertexScores[cache[i]] = vertexScore(i, numTrianglesLeft[cache[i]]);
+        }
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (int v : cache) {
+            for (int i = 0; i < numTrianglesLeft[v]; i++) {
+                const int t = vertexTriangles[triangleOffsets[v] + i];
+                const float score = vertexScores[indices[3 * t]] + vertexScores[indices[3 * t + 1]] + vertexScores[indices[3 * t + 2]];
+                if (score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = t;
+                }
+            }
+        }
+        
+        // Nothing left around the cache, start over from the next triangle in the original order
+        if (bestTriangle < 0) {
+            while (nextUnemitted < numTriangles && emitted[nextUnemitted]) {
+                nextUnemitted++;
+            }
+            bestTriangle = nextUnemitted < numTriangles ? nextUnemitted : -1;
+        }
+    }
+    
+    std::copy(optimized.begin(), optimized.end(), indices);
+}
+
+void optimizeVertexFetch(std::vector<SkinnedVertex> &vertices, std::vector<int> &indices)
+{
+    std::vector<int> remap(vertices.size(), -1);
+    std::vector<SkinnedVertex> reordered;
+    reordered.reserve(vertices.size());
+    for (int &index : indices) {
+        if (remap[index] < 0) {
+            remap[index] = (int)reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+float computeACMR(const int* indices, int numIndices, int numVertices, int cacheSize)
+{
+    const int numTriangles = numIndices / 3;
+    if (numTriangles == 0) {
+        return 0.0f;
+    }
+    
+    // A vertex is in the cache if it was added less than cacheSize misses ago
+    std::vector<int> addedAt(numVertices, -cacheSize - 1);
+    int misses = 0;
+    for (int i = 0; i < numTriangles * 3; i++) {
+        const int v = indices[i];
+        if (misses - addedAt[v] > cacheSize) {
+            addedAt[v] = misses;
+            misses++;
+        }
+    }
+    return (float)misses / numTriangles;
+}
+
+// Error quadric of Garland and Heckbert: the sum of the squared distances to a set of planes, as the symmetric matrix
+// [a b c d; . e f g; . . h i; . . . j], and the total weight of the planes
+struct Quadric {
+    double a = 0, b = 0, c = 0, d = 0, e = 0, f = 0, g = 0, h = 0, i = 0, j = 0;
+    double planes = 0;
+    
+    void addPlane(const glm::vec3 &normal, double distance, double weight)
+    {
+        a += weight * normal.x * normal.x;
+        b += weight * normal.x * normal.y;
+        c += weight * normal.x * normal.z;
+        d += weight * normal.x * distance;
+        e += weight * normal.y * normal.y;
+        f += weight * normal.y * normal.z;
+        g += weight * normal.y * distance;
+        h += weight * normal.z * normal.z;
+        i += weight * normal.z * distance;
+        j += weight * distance * distance;
+        planes += weight;
+    }
+    
+    void add(const Quadric &q)
+    {
+        a += q.a; b += q.b; c += q.c; d += q.d; e += q.e; f += q.f; g += q.g; h += q.h; i += q.i; j += q.j;
+        planes += q.planes;
+    }
+    
+    // Mean squared distance of p to the planes
+    double error(const glm::vec3 &p) const
+    {
+        if (planes == 0.0) {
+            return 0.0;
+        }
+        return (a * p.x * p.x + 2 * b * p.x * p.y + 2 * c * p.x * p.z + 2 * d * p.x
+             + e * p.y * p.y + 2 * f * p.y * p.z + 2 * g * p.y
+             + h * p.z * p.z + 2 * i * p.z
+             + j) / planes;
+    }
+};
+
+// Half the sum of the differences of the weights of every bone, 0 for vertices skinned alike and 1 for vertices
+// that share no bone
+static float weightDistance(const SkinnedVertex &a, const SkinnedVertex &b)
+{
+    float distance = 0.0f;
+    for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+        if (a.weights[i] == 0.0f) {
+            continue;
+        }
+        float other = 0.0f;
+        for (int k = 0; k < NUM_BONES_PER_VERTEX; k++) {
+            if (b.weights[k] != 0.0f && b.IDs[k] == a.IDs[i]) {
+                other = b.weights[k];
+            }
+        }
+        distance += std::abs(a.weights[i] - other);
+    }
+    for (int k = 0; k < NUM_BONES_PER_VERTEX; k++) {
+        bool shared = false;
+        for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+            shared = shared || (a.weights[i] != 0.0f && a.IDs[i] == b.IDs[k]);
+        }
+        if (!shared) {
+            distance += b.weights[k];
+        }
+    }
+    return 0.5f * distance;
+}
+
+static glm::vec3 triangleNormal(const glm::vec3 &p0, const glm::vec3 &p1, const glm::vec3 &p2)
+{
+    return glm::cross(p1 - p0, p2 - p0);
+}
+
+float simplifyMesh(const std::vector<SkinnedVertex> &vertices, const std::vector<int> &indices, int targetIndices, std::vector<int> &simplified)
+{
+    simplified = indices;
+    const int numVertices = (int)vertices.size();
+    if (indices.size() % 3 != 0 || (int)indices.size() <= targetIndices) {
+        return 0.0f;
+    }
+    
+    std::vector<glm::vec3> positions(numVertices);
+    for (int v = 0; v < numVertices; v++) {
+        positions[v] = glm::vec3(vertices[v].position);
+    }
+    
+    // Vertices at the same position are one corner of the surface split along a seam of texture coordinates,
+    // normals or weights. Edges are found between corners, so seams do not look like borders.
+    std::vector<int> corners(numVertices);
+    std::vector<int> numWedges(numVertices, 0);
+    {
+        std::map<std::tuple<float, float, float>, int> byPosition;
+        for (int v = 0; v < numVertices; v++) {
+            const glm::vec3 &p = vertices[v].position;
+            corners[v] = byPosition.insert(std::make_pair(std::make_tuple(p.x, p.y, p.z), v)).first->second;
+            numWedges[corners[v]]++;
+        }
+    }
+    
+    // Seams and borders stay where they are, so that the texture does not slide and the outline does not shrink
+    std::vector<bool> locked(numVertices, false);
+    {
+        std::map<std::pair<int, int>, int> edgeUses;
+        for (size_t t = 0; t < indices.size(); t += 3) {
+            for (int k = 0; k < 3; k++) {
+                const int a = corners[indices[t + k]];
+                const int b = corners[indices[t + (k + 1) % 3]];
+                edgeUses[std::make_pair(std::min(a, b), std::max(a, b))]++;
+            }
+        }
+        for (const auto &edge : edgeUses) {
+            if (edge.second != 2) {
+                locked[edge.first.first] = true;
+                locked[edge.first.second] = true;
+            }
+        }
+        for (int v = 0; v < numVertices; v++) {
+            locked[v] = locked[corners[v]] || numWedges[corners[v]] > 1;
+        }
+    }
+    
+    std::vector<Quadric> quadrics(numVertices);
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        const glm::vec3 normal = triangleNormal(positions[indices[t]], positions[indices[t + 1]], positions[indices[t + 2]]);
+        const double length = glm::length(normal);
+        if (length == 0.0) {
+            continue;
+        }
+        const glm::vec3 unit = normal / length;
+        for (int k = 0; k < 3; k++) {
+            quadrics[indices[t + k]].addPlane(unit, -glm::dot(unit, positions[indices[t]]), 1.0);
+        }
+    }
+    
+    double maxError = 0.0;
+    std::vector<int> vertexTriangles;
+    std::vector<int> triangleOffsets;
+    while ((int)simplified.size() > targetIndices) {
+        const int numTriangles = (int)simplified.size() / 3;
+        
+        // Triangles around every vertex
+        triangleOffsets.assign(numVertices + 1, 0);
+        for (int index : simplified) {
+            triangleOffsets[index + 1]++;
+        }
+        for (int v = 0; v < numVertices; v++) {
+            triangleOffsets[v + 1] += triangleOffsets[v];
+        }
+        vertexTriangles.resize(simplified.size());
+        std::vector<int> filled(triangleOffsets.begin(), triangleOffsets.end() - 1);
+        for (int t = 0; t < numTriangles; t++) {
+            for (int k = 0; k < 3; k++) {
+                vertexTriangles[filled[simplified[3 * t + k]]++] = t;
+            }
+        }
+        
+        // Every vertex can move onto the other end of each of its edges. Moving across different skin weights costs
+        // as much as moving the vertex off the surface by the part of the edge they differ by.
+        struct Collapse {
+            int from;
+            int to;
+            double error;
+        };
+        std::vector<Collapse> collapses;
+        for (int t = 0; t < numTriangles; t++) {
+            for (int k = 0; k < 3; k++) {
+                const int from = simplified[3 * t + k];
+                const int to = simplified[3 * t + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++) {
+                    const int a = direction == 0 ? from : to;
+                    const int b = direction == 0 ? to : from;
+                    if (locked[a] || a == b) {
+                        continue;
+                    }
+                    const double skinning = weightDistance(vertices[a], vertices[b]) * glm::length(positions[a] - positions[b]);
+                    const Collapse collapse = { a, b, std::max(0.0, quadrics[a].error(positions[b])) + skinning * skinning };
+                    collapses.push_back(collapse);
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.error < y.error; });
+        
+        // The cheapest collapses whose triangles do not overlap, until the target is reached
+        std::vector<bool> touched(numVertices, false);
+        int numRemoved = 0;
+        const int numToRemove = (numTriangles * 3 - targetIndices) / 3;
+        for (const Collapse &collapse : collapses) {
+            if (numRemoved >= numToRemove) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            
+            // Reject collapses that flip a triangle that stays
+            bool flips = false;
+            int removes = 0;
+            for (int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1] && !flips; i++) {
+                const int* triangle = &simplified[3 * vertexTriangles[i]];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                    removes++;
+                    continue;
+                }
+                glm::vec3 corner[3];
+                for (int k = 0; k < 3; k++) {
+                    corner[k] = positions[triangle[k] == collapse.from ? collapse.to : triangle[k]];
+                }
+                const glm::vec3 before = triangleNormal(positions[triangle[0]], positions[triangle[1]], positions[triangle[2]]);
+                const glm::vec3 after = triangleNormal(corner[0], corner[1], corner[2]);
+                flips = glm::dot(before, after) <= 0.0;
+            }
+            if (flips) {
+                continue;
+            }
+            
+            // Neighbors are left alone for the rest of the pass, their triangles change
+            for (int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++) {
+                int* triangle = &simplified[3 * vertexTriangles[i]];
+                for (int k = 0; k < 3; k++) {
+                    touched[triangle[k]] = true;
+                    if (triangle[k] == collapse.from) {
+                        triangle[k] = collapse.to;
+                    }
+                }
+            }
+            quadrics[collapse.to].add(quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+            numRemoved += removes;
+        }
+        
+        if (numRemoved == 0) {
+            break;
+        }
+        
+        // Drop the triangles that collapsed
+        int kept = 0;
+        for (int t = 0; t < numTriangles; t++) {
+            const int i0 = simplified[3 * t];
+            const int i1 = simplified[3 * t + 1];
+            const int i2 = simplified[3 * t + 2];
+            if (i0 != i1 && i1 != i2 && i0 != i2) {
+                simplified[kept++] = i0;
+                simplified[kept++] = i1;
+                simplified[kept++] = i2;
+            }
+        }
+        simplified.resize(kept);
+    }
+    
+    return (float)std::sqrt(maxError);
+}
@@ -0,0 +1,64 @@
+///
+///  MeshOptimizer.h
+///
+///  \brief Reorders imported meshes for the GPU. Identical vertices are welded, triangles are reordered so that their
+///         vertices are still in the post-transform cache when they are reused (Forsyth's linear-speed vertex cache
+///         optimization), and vertices are renumbered in the order the triangles first use them, so that they are
+///         fetched from memory in order. How well the cache is used is measured by the ACMR, the average number of
+///         vertices transformed per triangle: 3 without any reuse, around 0.6 for a well ordered regular mesh.
+///
+///         Levels of detail are simplified from the mesh by collapsing edges in the order of the quadric error of
+///         Garland and Heckbert, each vertex moving onto a neighbor. Vertices are never moved or created, so every
+///         level keeps the texture coordinates and skin weights of the vertices it keeps, and draws from the same
+///         vertex buffer with its own indices.
+///
+
+#ifndef MeshOptimizer_hpp
+#define MeshOptimizer_hpp
+
+#include <vector>
+#include "SkinnedVertex.h"
+
+
+// Entries of the least recently used cache the optimizer orders for
+#define VERTEX_CACHE_SIZE 32
+
+// Entries of the first-in first-out cache the ACMR is measured with, the size of common post-transform caches
+#define ACMR_CACHE_SIZE 16
+
+// Levels of detail generated per mesh, the first being the mesh itself
+#define NUM_LODS 4
+
+// Fraction of the triangles of the mesh each level keeps, and the largest number of influences it is skinned with
+static const float LOD_TRIANGLE_RATIOS[NUM_LODS] = { 1.0f, 0.5f, 0.25f, 0.125f };
+static const int LOD_MAX_INFLUENCES[NUM_LODS] = { 8, 4, 2, 1 };
+
+// How an optimized mesh changed
+struct MeshOptimizerStats {
+    int numVertices = 0;            // imported
+    int numWeldedVertices = 0;      // left after welding
+    int numTriangles = 0;
+    float acmrBefore = 0.0f;
+    float acmrAfter = 0.0f;
+};
+
+// Merges vertices that are equal in every attribute and updates indices. Returns the number of vertices left.
+int weldVertices(std::vector<SkinnedVertex> &vertices, std::vector<int> &indices);
+
+// Reorders the numIndices / 3 triangles starting at indices for the vertex cache. Triangles are not mixed with the
+// indices outside that range, so each draw range can be optimized on its own.
+void optimizeVertexCache(int* indices, int numIndices, int numVertices);
+
+// Renumbers vertices in the order indices first use them. Vertices that no index uses are dropped.
+void optimizeVertexFetch(std::vector<SkinnedVertex> &vertices, std::vector<int> &indices);
+
+// Collapses edges of the triangles in indices until at most targetIndices indices are left, or no collapse is possible,
+// and writes the remaining triangles to simplified. Vertices on seams, where vertices share a position, and on borders
+// are never moved; moving a vertex onto one with other skin weights counts as an error proportional to the difference.
+// Returns the error of the costliest collapse, roughly the farthest a vertex moved off the surface in model units.
+float simplifyMesh(const std::vector<SkinnedVertex> &vertices, const std::vector<int> &indices, int targetIndices, std::vector<int> &simplified);
+
+// Average number of vertices transformed per triangle, with a first-in first-out cache of cacheSize vertices
+float computeACMR(const int* indices, int numIndices, int numVertices, int cacheSize = ACMR_CACHE_SIZE);
+
+#endif /* MeshOptimizer_hpp */
@@ -0,0 +1,191 @@
+//
+//  PaletteBuffer.cpp
+//
+
+#include "PaletteBuffer.h"
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+
+// glClientWaitSync cannot wait forever, so fences are waited on a millisecond at a time
+static const GLuint64 FENCE_TIMEOUT = 1000000;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static bool hasBufferStorage()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+#endif
+}
+
+PaletteBuffer::PaletteBuffer(size_t bytesPerFrame, int numFrames) :
+    _buffer(0), _texture(0), _mapped(nullptr), _region(numFrames - 1), _writeOffset(0), _full(false), _fences(numFrames, nullptr),
+    _frameOffset(0)
+{
+    _regionSize = alignUp(bytesPerFrame, TEXEL_SIZE);
+    
+    const GLsizeiptr bufferSize = (GLsizeiptr)(_regionSize * numFrames);
+    GLint maxTexels = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+    if (bufferSize / TEXEL_SIZE > (size_t)maxTexels) {
+        std::cout << "Palette buffer of " << bufferSize << " bytes is larger than the " << maxTexels << " texels a texture buffer can read" << std::endl;
+    }
+    
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+#ifndef __APPLE__
+    if (hasBufferStorage()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_TEXTURE_BUFFER, bufferSize, nullptr, flags);
+        _mapped = (unsigned char*)glMapBufferRange(GL_TEXTURE_BUFFER, 0, bufferSize, flags);
+    }
+#endif
+    if (!_mapped) {
+        glBufferData(GL_TEXTURE_BUFFER, bufferSize, nullptr, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, _texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, _buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+PaletteBuffer::~PaletteBuffer()
+{
+    for (GLsync fence : _fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    glDeleteTextures(1, &_texture);
+    if (_mapped) {
+        glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+        glUnmapBuffer(GL_TEXTURE_BUFFER);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    glDeleteBuffers(1, &_buffer);
+}
+
+void PaletteBuffer::beginFrame()
+{
+    // Everything drawn so far read the region of the previous frame
+    if (_fences[_region]) {
+        glDeleteSync(_fences[_region]);
+    }
+    _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    
+    _region = (_region + 1) % (int)_fences.size();
+    if (_fences[_region]) {
+        while (glClientWaitSync(_fences[_region], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED) {
+        }
+        glDeleteSync(_fences[_region]);
+        _fences[_region] = nullptr;
+    }
+    _writeOffset = 0;
+    _full = false;
+}
+
+PaletteBuffer::Range PaletteBuffer::write(const void* data, size_t size)
+{
+    Range range;
+    assert(size % TEXEL_SIZE == 0);
+    if (_writeOffset + size > _regionSize) {
+        if (!_full) {
+            std::cout << "Palette buffer is full, " << _regionSize << " bytes per frame are not enough" << std::endl;
+            _full = true;
+        }
+        return range;
+    }
+    
+    const size_t offset = _region * _regionSize + _writeOffset;
+    range.offset = (GLint)(offset / TEXEL_SIZE);
+    range.size = (GLint)(size / TEXEL_SIZE);
+    if (_mapped) {
+        memcpy(_mapped + offset, data, size);
+    }
+    else {
+        glBindBuffer(GL_TEXTURE_BUFFER, _buffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, (GLintptr)offset, (GLsizeiptr)size, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+    _writeOffset += size;
+    
+    return range;
+}
+
+bool PaletteBuffer::upload(const PaletteFrame &frame)
+{
+    if (frame.getSize() == 0) {
+        _frameOffset = (GLint)((_region * _regionSize + _writeOffset) / TEXEL_SIZE);
+        return true;
+    }
+    const Range range = write(frame.getData(), frame.getSize());
+    _frameOffset = range.offset;
+    return range.size != 0;
+}
+
+GLint PaletteBuffer::getFrameOffset() const
+{
+    return _frameOffset;
+}
+
+void PaletteBuffer::bind() const
+{
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, _texture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+bool PaletteBuffer::isPersistent() const
+{
+    return _mapped != nullptr;
+}
+
+
+PaletteFrame::PaletteFrame(size_t maxBytes) : _maxBytes(maxBytes), _full(false)
+{
+    _data.reserve(maxBytes);
+}
+
+void PaletteFrame::clear()
+{
+    _data.clear();
+    _full = false;
+}
+
+PaletteBuffer::Range PaletteFrame::write(const void* data, size_t size)
+{
+    PaletteBuffer::Range range;
+    assert(size % PaletteBuffer::TEXEL_SIZE == 0);
+    if (_data.size() + size > _maxBytes) {
+        if (!_full) {
+            std::cout << "Palette frame is full, " << _maxBytes << " bytes per frame are not enough" << std::endl;
+            _full = true;
+        }
+        return range;
+    }
+    
+    range.offset = (GLint)(_data.size() / PaletteBuffer::TEXEL_SIZE);
+    range.size = (GLint)(size / PaletteBuffer::TEXEL_SIZE);
+    _data.insert(_data.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+    return range;
+}
+
+const unsigned char* PaletteFrame::getData() const
+{
+    return _data.empty() ? nullptr : &_data[0];
+}
+
+size_t PaletteFrame::getSize() const
+{
+    return _data.size();
+}
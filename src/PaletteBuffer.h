@@ -0,0 +1,125 @@
+///
+///  PaletteBuffer.h
+///
+///  \brief Streams the bone palettes of every instance to the GPU once per frame, into a buffer split into one region
+///         per frame in flight. A frame writes its palettes into its own region while the GPU may still read the
+///         others, and a fence keeps a region from being overwritten before the draws reading it are done. Shaders
+///         fetch the palettes through a texture buffer at the texel offset of their instance, so palettes are sized
+///         to the skeleton and the number of bones is only limited by the size of the buffer.
+///
+///         The palettes are written once per frame into a PaletteFrame on the CPU, and every GL context copies that
+///         frame whole into its own PaletteBuffer. Offsets within the frame are the same in every context; shaders
+///         add the paletteOffset uniform, where the context's copy starts.
+///
+
+#ifndef PaletteBuffer_hpp
+#define PaletteBuffer_hpp
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _WIN32
+#include "GL/glew.h"
+#include "GL/wglew.h"
+#elif (!defined(__APPLE__))
+#include "GL/glxew.h"
+#endif
+
+// OpenGL Headers
+#if defined(WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <GL/gl.h>
+#elif defined(__APPLE__)
+#define GL_GLEXT_PROTOTYPES
+#include <OpenGL/gl3.h>
+#include <OpenGL/glext.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#endif
+
+
+class PaletteFrame;
+
+class PaletteBuffer
+{
+public:
+    
+    // Texture unit the "palette" samplerBuffer of the skinning shaders reads, above those of the materials
+    static const GLint TEXTURE_UNIT = 15;
+    
+    // Palettes are fetched as RGBA32F texels, three per bone matrix (its rows, the last one is implied) and two per
+    // dual quaternion
+    static const size_t TEXEL_SIZE = 4 * sizeof(float);
+    
+    // Texels of the buffer holding one palette. Empty if it did not fit.
+    struct Range {
+        GLint offset = 0;
+        GLint size = 0;
+    };
+    
+    // Needs a current GL context. bytesPerFrame bounds the palettes written in a frame; numFrames regions let the CPU
+    // run that many frames ahead of the GPU.
+    explicit PaletteBuffer(size_t bytesPerFrame, int numFrames = 3);
+    ~PaletteBuffer();
+    
+    // Moves on to the next region and waits until the GPU is done with it. Call once per frame, before writing.
+    void beginFrame();
+    
+    // Copies size bytes, a multiple of TEXEL_SIZE, into the region of this frame
+    Range write(const void* data, size_t size);
+    
+    // Copies the palettes of frame into the region of this frame, false if they did not fit. Ranges of the frame
+    // start getFrameOffset() texels into the buffer.
+    bool upload(const PaletteFrame &frame);
+    GLint getFrameOffset() const;
+    
+    // Binds the texture buffer to TEXTURE_UNIT for the following draws
+    void bind() const;
+    
+    // True when the buffer is mapped once for good (GL 4.4 or ARB_buffer_storage). Otherwise every write is a
+    // glBufferSubData into a region the GPU is no longer reading.
+    bool isPersistent() const;
+
+private:
+    
+    PaletteBuffer(const PaletteBuffer&) = delete;
+    PaletteBuffer& operator=(const PaletteBuffer&) = delete;
+    
+    GLuint _buffer;
+    GLuint _texture;                    // GL_TEXTURE_BUFFER over all of _buffer
+    unsigned char* _mapped;             // whole buffer, null unless persistent
+    size_t _regionSize;
+    int _region;                        // written this frame
+    size_t _writeOffset;                // within the region
+    bool _full;                         // reported once per frame
+    std::vector<GLsync> _fences;        // one per region, set when the frames after it start
+    GLint _frameOffset;                 // texel of the last upload
+};
+
+// The palettes and instance records of one frame, written on the CPU without a GL context
+class PaletteFrame
+{
+public:
+    
+    // maxBytes bounds the palettes of a frame, as for PaletteBuffer
+    explicit PaletteFrame(size_t maxBytes);
+    
+    // Empties the frame. Call once per frame, before writing.
+    void clear();
+    
+    // Appends size bytes, a multiple of PaletteBuffer::TEXEL_SIZE. Ranges are in texels from the start of the frame.
+    PaletteBuffer::Range write(const void* data, size_t size);
+    
+    const unsigned char* getData() const;
+    size_t getSize() const;
+
+private:
+    
+    std::vector<unsigned char> _data;
+    size_t _maxBytes;
+    bool _full;                         // reported once per frame
+};
+
+#endif /* PaletteBuffer_hpp */
@@ -0,0 +1,109 @@
+//
+//  PaletteCache.cpp
+//
+
+#include "PaletteCache.h"
+#include "PoseEvaluator.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+PaletteCache::PaletteCache(const std::shared_ptr<const SkinnedModelData> &asset, float framesPerSecond) :
+    _numBones(asset->getNumBones()), _framesPerSecond(framesPerSecond)
+{
+    // The frames are sampled with the evaluator AnimationInstance uses, so they match what it would draw
+    PoseEvaluator pose(*asset);
+    std::vector<Affine3x4> exactPalette(_numBones, toAffine(glm::mat4(1.0)));
+    
+    for (int c = 0; c < asset->getNumClips(); c++) {
+        const SkinnedModelData::Clip &clip = asset->getClip(c);
+        
+        // Clips with a single key, or none, have no duration and bake one frame. Files without a rate get Assimp's.
+        BakedClip baked;
+        const float ticksPerSecond = clip.ticksPerSecond > 0.0f ? clip.ticksPerSecond : 25.0f;
+        baked.durationInSecs = clip.duration > 0.0f ? clip.duration / ticksPerSecond : 0.0f;
+        baked.numFrames = baked.durationInSecs > 0.0f ? std::max(1, (int)std::ceil(baked.durationInSecs * framesPerSecond)) : 1;
+        baked.palettes.resize(baked.numFrames * _numBones);
+        
+        for (int f = 0; f < baked.numFrames; f++) {
+            pose.evaluate(c, baked.durationInSecs * f / baked.numFrames, exactPalette);
+            std::copy(exactPalette.begin(), exactPalette.end(), baked.palettes.begin() + f * _numBones);
+        }
+        
+        _clips.push_back(std::move(baked));
+        
+        // Measure the error where it is largest, halfway between two frames
+        ClipStats stats;
+        stats.numFrames = _clips.back().numFrames;
+        stats.bytes = _clips.back().palettes.size() * sizeof(Affine3x4);
+        stats.maxError = 0.0f;
+        stats.meanError = 0.0f;
+        
+        std::vector<Affine3x4> blended;
+        for (int f = 0; f < stats.numFrames; f++) {
+            const float time = _clips.back().durationInSecs * (f + 0.5f) / stats.numFrames;
+            pose.evaluate(c, time, exactPalette);
+            sample(c, time, blended);
+            
+            for (int b = 0; b < _numBones; b++) {
+                for (int row = 0; row < 3; row++) {
+                    for (int col = 0; col < 4; col++) {
+                        const float error = std::fabs(blended[b].m[row][col] - exactPalette[b].m[row][col]);
+                        stats.maxError = std::max(stats.maxError, error);
+                        stats.meanError += error;
+                    }
+                }
+            }
+        }
+        if (_numBones > 0) {
+            stats.meanError /= stats.numFrames * _numBones * 12;
+        }
+        
+        std::cout << "Baked clip " << c << " '" << clip.name << "': " << stats.numFrames << " frames, "
+                  << stats.bytes / 1024.0f << " KB, max error " << stats.maxError << ", mean error " << stats.meanError << std::endl;
+        
+        _stats.push_back(stats);
+    }
+}
+
+float PaletteCache::getFramesPerSecond() const
+{
+    return _framesPerSecond;
+}
+
+const PaletteCache::ClipStats& PaletteCache::getStats(int clip) const
+{
+    return _stats[clip];
+}
+
+void PaletteCache::sample(int clip, float timeInSecs, std::vector<Affine3x4> &palette) const
+{
+    const BakedClip &baked = _clips[clip];
+    
+    // A clip without duration is its first frame at any time
+    int frame = 0;
+    float factor = 0.0f;
+    if (baked.durationInSecs > 0.0f) {
+        float position = std::fmod(timeInSecs, baked.durationInSecs) / baked.durationInSecs * baked.numFrames;
+        if (position < 0.0f) {
+            position += baked.numFrames;
+        }
+        frame = std::min((int)position, baked.numFrames - 1);
+        factor = position - frame;
+    }
+    const int nextFrame = (frame + 1) % baked.numFrames;
+    
+    // Matrices are blended entry by entry, which is close enough at a sample rate where neighbouring frames are similar
+    const Affine3x4* start = &baked.palettes[frame * _numBones];
+    const Affine3x4* end = &baked.palettes[nextFrame * _numBones];
+    
+    palette.resize(_numBones);
+    for (int b = 0; b < _numBones; b++) {
+        for (int r = 0; r < 3; r++) {
+            for (int c = 0; c < 4; c++) {
+                palette[b].m[r][c] = start[b].m[r][c] + factor * (end[b].m[r][c] - start[b].m[r][c]);
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+///
+///  PaletteCache.h
+///
+///  \brief Bone palettes of every clip of an asset, sampled at a fixed rate when the cache is built. An instance
+///         playing from the cache only looks up the two frames around its time and blends them, instead of
+///         interpolating every channel. Meant for looping background characters, where the small error does not show.
+///
+
+#ifndef PaletteCache_hpp
+#define PaletteCache_hpp
+
+#include <memory>
+#include <vector>
+#include "SkinnedModelData.h"
+#include "PoseKernel.h"
+
+
+class PaletteCache
+{
+public:
+    
+    // Size of a baked clip and how far its blended frames are from the exact pose
+    struct ClipStats {
+        int numFrames;
+        size_t bytes;
+        float maxError;     // largest difference of a palette entry, halfway between two frames. Clips that do not
+                            // end in their first pose also count the jump back to the start, which the cache smooths.
+        float meanError;
+    };
+    
+    // Samples every clip of asset about framesPerSecond times per second. The rate is adjusted so that a whole
+    // number of frames fits in each clip and the last frame blends into the first one.
+    PaletteCache(const std::shared_ptr<const SkinnedModelData> &asset, float framesPerSecond);
+    
+    float getFramesPerSecond() const;
+    const ClipStats& getStats(int clip) const;
+    
+    // Writes the palette of clip at timeInSecs (wrapped to the clip length), blended from the two closest frames
+    void sample(int clip, float timeInSecs, std::vector<Affine3x4> &palette) const;
+    
+private:
+    
+    struct BakedClip {
+        float durationInSecs;
+        int numFrames;
+        std::vector<Affine3x4> palettes;    // numFrames palettes of numBones matrices, one after the other
+    };
+    
+    int _numBones;
+    float _framesPerSecond;
+    std::vector<BakedClip> _clips;
+    std::vector<ClipStats> _stats;
+};
+
+#endif /* PaletteCache_hpp */
@@ -0,0 +1,173 @@
+//
+//  PoseEvaluator.cpp
+//
+
+#include "PoseEvaluator.h"
+#include "KeyframeSearch.h"
+
+#include <cmath>
+
+
+PoseEvaluator::PoseEvaluator(const SkinnedModelData &model) :
+    _model(&model), _clip(-1)
+{
+    const int numNodes = _model->getSkeleton().getNumNodes();
+    _localTransforms.resize(numNodes);
+    _globalTransforms.resize(numNodes);
+    _cursors.assign(numNodes, KeyCursor());
+}
+
+void PoseEvaluator::evaluate(int clip, float timeInSecs, std::vector<Affine3x4> &palette)
+{
+    if (palette.size() != _model->getNumBones()) {
+        palette.assign(_model->getNumBones(), toAffine(glm::mat4(1.0)));
+    }
+    
+    // Cursors belong to the keys of the previous clip
+    if (clip != _clip) {
+        _cursors.assign(_cursors.size(), KeyCursor());
+        _clip = clip;
+    }
+    
+    // Clips without duration, with single keys, hold their pose at any time
+    const SkinnedModelData::Clip &data = _model->getClip(clip);
+    float timeInTicks = timeInSecs * data.ticksPerSecond;
+    float animationTime = data.duration > 0.0f ? std::fmod(timeInTicks, data.duration) : 0.0f;
+    
+    evaluatePose(animationTime, data, palette);
+}
+
+
+//Interpolates the local transform of every animated node with the batch kernel, then composes them with their parents in skeleton order
+void PoseEvaluator::evaluatePose(float AnimationTime, const SkinnedModelData::Clip &clip, std::vector<Affine3x4> &palette){
+    
+    const Skeleton &skeleton = _model->getSkeleton();
+    const int numNodes = skeleton.getNumNodes();
+    const int numSlots = (int)clip.channels.size();
+    
+    //find the keys around the animation time for each channel
+    if (_poseStreams.size() != numSlots) {
+        _poseStreams.resize(numSlots);
+        _sampledTransforms.resize(_poseStreams.paddedSize());
+    }
+    for (int slot = 0; slot < numSlots; slot++) {
+        const CompressedChannel &channel = clip.channels[slot];
+        KeyCursor &cursor = _cursors[clip.nodes[slot]];
+        
+        GatherScaling(slot, AnimationTime, channel, &cursor);
+        GatherRotation(slot, AnimationTime, channel, &cursor);
+        GatherPosition(slot, AnimationTime, channel, &cursor);
+    }
+    
+    //interpolate and combine translation * rotation * scaling of all channels at once
+    composeTRS(_poseStreams, &_sampledTransforms[0]);
+    
+    for (int i = 0; i < numNodes; i++) {
+        const int slot = clip.nodeSlots[i];
+        _localTransforms[i] = slot >= 0 ? _sampledTransforms[slot] : skeleton.getNode(i).localTransform;
+    }
+    
+    //Multiply node transformations by their parents to get resulting transforms, relative to the root of the model
+    skeleton.localToGlobal(&_localTransforms[0], _model->getGlobalInverseTransform(), &_globalTransforms[0]);
+    
+    //Set bone transformations from nodes
+    for (int i = 0; i < numNodes; i++) {
+        const int BoneIndex = skeleton.getNode(i).boneIndex;
+        if (BoneIndex >= 0) {
+            multiplyAffine(_globalTransforms[i], _model->getBoneOffset(BoneIndex), palette[BoneIndex]);
+        }
+    }
+}
+
+
+//Calculate how far along we are from one key to the next (btw 0 and 1). Keys at the same time give the first.
+static float keyFactor(float AnimationTime, float startTime, float endTime)
+{
+    float DeltaTime = endTime - startTime;
+    if (!(DeltaTime > 0.0f)) {
+        return 0.0f;
+    }
+    float Factor = (AnimationTime - startTime) / DeltaTime;
+    return std::min(std::max(Factor, 0.0f), 1.0f);
+}
+
+//Store the position keys around the animation time in the pose streams
+void PoseEvaluator::GatherPosition(int slot, float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor)
+{
+    if (channel.position.getNumKeys() == 1) {
+        const glm::vec3 value = channel.position.getValue(0);
+        _poseStreams.setTranslation(slot, value, value, 0.0f);
+        return;
+    }
+    
+    //find animation closest to current time, and next animation
+    uint PositionIndex = FindPosition(AnimationTime, channel, cursor);
+    const float* Times = channel.position.getTimes();
+    
+    _poseStreams.setTranslation(slot, channel.position.getValue(PositionIndex), channel.position.getValue(PositionIndex + 1), keyFactor(AnimationTime, Times[PositionIndex], Times[PositionIndex + 1]));
+}
+
+//Store the rotation keys around the animation time in the pose streams
+void PoseEvaluator::GatherRotation(int slot, float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor)
+{
+    if (channel.rotation.getNumKeys() == 1) {
+        const glm::vec4 value = channel.rotation.getValue(0);
+        _poseStreams.setRotation(slot, value, value, 0.0f);
+        return;
+    }
+    
+    //find animation closest to current time, and next animation
+    uint RotationIndex = FindRotation(AnimationTime, channel, cursor);
+    const float* Times = channel.rotation.getTimes();
+    
+    _poseStreams.setRotation(slot, channel.rotation.getValue(RotationIndex), channel.rotation.getValue(RotationIndex + 1), keyFactor(AnimationTime, Times[RotationIndex], Times[RotationIndex + 1]));
+}
+
+//Store the scaling keys around the animation time in the pose streams
+void PoseEvaluator::GatherScaling(int slot, float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor)
+{
+    if (channel.scaling.getNumKeys() == 1) {
+        const glm::vec3 value = channel.scaling.getValue(0);
+        _poseStreams.setScaling(slot, value, value, 0.0f);
+        return;
+    }
+    
+    //find animation closest to current time, and next animation
+    uint ScalingIndex = FindScaling(AnimationTime, channel, cursor);
+    const float* Times = channel.scaling.getTimes();
+    
+    _poseStreams.setScaling(slot, channel.scaling.getValue(ScalingIndex), channel.scaling.getValue(ScalingIndex + 1), keyFactor(AnimationTime, Times[ScalingIndex], Times[ScalingIndex + 1]));
+}
+
+//Find closest translation animation to a given animation time
+uint PoseEvaluator::FindPosition(float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor)
+{
+    assert(channel.position.getNumKeys() > 1);
+    
+    if (cursor) {
+        return findKey(AnimationTime, channel.position.getTimes(), channel.position.getNumKeys(), cursor->position);
+    }
+    return findKey(AnimationTime, channel.position.getTimes(), channel.position.getNumKeys());
+}
+
+//Find closest rotation animation to a given animation time
+uint PoseEvaluator::FindRotation(float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor)
+{
+    assert(channel.rotation.getNumKeys() > 1);
+    
+    if (cursor) {
+        return findKey(AnimationTime, channel.rotation.getTimes(), channel.rotation.getNumKeys(), cursor->rotation);
+    }
+    return findKey(AnimationTime, channel.rotation.getTimes(), channel.rotation.getNumKeys());
+}
+
+//Find closest scaling animation to a given animation time
+uint PoseEvaluator::FindScaling(float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor)
+{
+    assert(channel.scaling.getNumKeys() > 1);
+    
+    if (cursor) {
+        return findKey(AnimationTime, channel.scaling.getTimes(), channel.scaling.getNumKeys(), cursor->scaling);
+    }
+    return findKey(AnimationTime, channel.scaling.getTimes(), channel.scaling.getNumKeys());
+}
@@ -0,0 +1,58 @@
+///
+///  PoseEvaluator.h
+///
+///  \brief Samples the clips of a SkinnedModelData into bone palettes: keys around the time are gathered per channel,
+///         interpolated with the batch kernel and composed down the skeleton. Keeps the scratch space and the key
+///         cursors of one playback, so every character playing a model owns its own evaluator.
+///
+
+#ifndef PoseEvaluator_hpp
+#define PoseEvaluator_hpp
+
+#include <vector>
+#include "SkinnedModelData.h"
+#include "PoseKernel.h"
+
+
+class PoseEvaluator
+{
+public:
+    
+    // model must outlive the evaluator
+    explicit PoseEvaluator(const SkinnedModelData &model);
+    
+    // Evaluates clip at timeInSecs (wrapped to the clip length) and writes the transform of every bone to palette,
+    // which is resized to getNumBones() if needed. Entries of bones that no node moves are left as they are.
+    void evaluate(int clip, float timeInSecs, std::vector<Affine3x4> &palette);
+
+private:
+    
+    // Last keyframe interval used by each track, so that forward playback does not search the keys again
+    struct KeyCursor {
+        uint position = 0;
+        uint rotation = 0;
+        uint scaling = 0;
+    };
+    
+    const SkinnedModelData* _model;
+    int _clip;                                  // clip the cursors belong to
+    std::vector<KeyCursor> _cursors;            // one per skeleton node
+    
+    // Scratch space for pose evaluation
+    TRSStreams _poseStreams;                    // keys around the current time, one slot per animated node
+    std::vector<Affine3x4> _sampledTransforms;  // one per slot
+    std::vector<Affine3x4> _localTransforms;    // one per skeleton node
+    std::vector<Affine3x4> _globalTransforms;   // one per skeleton node
+    
+    void evaluatePose(float AnimationTime, const SkinnedModelData::Clip &clip, std::vector<Affine3x4> &palette);
+    
+    // cursor is optional, without it the keys are binary searched
+    void GatherScaling(int slot, float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor = nullptr);
+    void GatherRotation(int slot, float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor = nullptr);
+    void GatherPosition(int slot, float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor = nullptr);
+    uint FindScaling(float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor = nullptr);
+    uint FindRotation(float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor = nullptr);
+    uint FindPosition(float AnimationTime, const CompressedChannel &channel, KeyCursor* cursor = nullptr);
+};
+
+#endif /* PoseEvaluator_hpp */
@@ -0,0 +1,363 @@
+//
+//  PoseKernel.cpp
+//
+
+#include "PoseKernel.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define POSE_KERNEL_AVX2
+#define POSE_KERNEL_SSE
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define POSE_KERNEL_SSE
+#endif
+
+
+Affine3x4 toAffine(const glm::mat4 &matrix)
+{
+    Affine3x4 affine;
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            affine.m[r][c] = matrix[c][r];
+        }
+    }
+    return affine;
+}
+
+glm::mat4 toMat4(const Affine3x4 &affine)
+{
+    glm::mat4 matrix(1.0f);
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            matrix[c][r] = affine.m[r][c];
+        }
+    }
+    return matrix;
+}
+
+void multiplyAffine(const Affine3x4 &a, const Affine3x4 &b, Affine3x4 &out)
+{
+#ifdef POSE_KERNEL_SSE
+    // Each row of the product is a linear combination of the rows of b, plus the translation of a
+    const __m128 b0 = _mm_loadu_ps(b.m[0]);
+    const __m128 b1 = _mm_loadu_ps(b.m[1]);
+    const __m128 b2 = _mm_loadu_ps(b.m[2]);
+    const __m128 translation = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+    
+    __m128 rows[3];
+    for (int r = 0; r < 3; r++) {
+        __m128 row = _mm_mul_ps(_mm_set1_ps(a.m[r][0]), b0);
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[r][1]), b1));
+        row = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[r][2]), b2));
+        rows[r] = _mm_add_ps(row, _mm_mul_ps(_mm_set1_ps(a.m[r][3]), translation));
+    }
+    for (int r = 0; r < 3; r++) {
+        _mm_storeu_ps(out.m[r], rows[r]);
+    }
+#else
+    Affine3x4 product;
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            product.m[r][c] = a.m[r][0] * b.m[0][c] + a.m[r][1] * b.m[1][c] + a.m[r][2] * b.m[2][c];
+        }
+        product.m[r][3] += a.m[r][3];
+    }
+    out = product;
+#endif
+}
+
+DualQuaternion toDualQuaternion(const Affine3x4 &affine)
+{
+    // Rotation part with each column normalized, so that scaled bones still give a unit quaternion
+    float r[3][3];
+    for (int c = 0; c < 3; c++) {
+        const float length = std::sqrt(affine.m[0][c] * affine.m[0][c] + affine.m[1][c] * affine.m[1][c] + affine.m[2][c] * affine.m[2][c]);
+        for (int row = 0; row < 3; row++) {
+            r[row][c] = length > 0.0f ? affine.m[row][c] / length : 0.0f;
+        }
+    }
+    
+    // Divide by the largest of the four possible terms to stay accurate near 180 degree rotations
+    glm::vec4 q;
+    const float trace = r[0][0] + r[1][1] + r[2][2];
+    if (trace > 0.0f) {
+        const float s = std::sqrt(trace + 1.0f) * 2.0f;
+        q = glm::vec4((r[2][1] - r[1][2]) / s, (r[0][2] - r[2][0]) / s, (r[1][0] - r[0][1]) / s, 0.25f * s);
+    }
+    else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+        const float s = std::sqrt(1.0f + r[0][0] - r[1][1] - r[2][2]) * 2.0f;
+        q = glm::vec4(0.25f * s, (r[0][1] + r[1][0]) / s, (r[0][2] + r[2][0]) / s, (r[2][1] - r[1][2]) / s);
+    }
+    else if (r[1][1] > r[2][2]) {
+        const float s = std::sqrt(1.0f + r[1][1] - r[0][0] - r[2][2]) * 2.0f;
+        q = glm::vec4((r[0][1] + r[1][0]) / s, 0.25f * s, (r[1][2] + r[2][1]) / s, (r[0][2] - r[2][0]) / s);
+    }
+    else {
+        const float s = std::sqrt(1.0f + r[2][2] - r[0][0] - r[1][1]) * 2.0f;
+        q = glm::vec4((r[0][2] + r[2][0]) / s, (r[1][2] + r[2][1]) / s, 0.25f * s, (r[1][0] - r[0][1]) / s);
+    }
+    q = glm::normalize(q);
+    
+    // dual = 0.5 * (t, 0) * q
+    const glm::vec3 t(affine.m[0][3], affine.m[1][3], affine.m[2][3]);
+    const glm::vec3 v(q.x, q.y, q.z);
+    
+    DualQuaternion result;
+    result.real = q;
+    result.dual = 0.5f * glm::vec4(q.w * t + glm::cross(t, v), -glm::dot(t, v));
+    return result;
+}
+
+
+TRSStreams::TRSStreams() : _size(0), _paddedSize(0)
+{
+}
+
+void TRSStreams::resize(int size)
+{
+    _size = size;
+    _paddedSize = (size + POSE_KERNEL_PADDING - 1) / POSE_KERNEL_PADDING * POSE_KERNEL_PADDING;
+    _data.assign(NUM_COMPONENTS * _paddedSize, 0.0f);
+    
+    // Identity rotation and unit scale, so that the padding never divides by zero
+    const Component ones[] = { R0W, R1W, S0X, S0Y, S0Z, S1X, S1Y, S1Z };
+    for (int i = 0; i < (int)(sizeof(ones) / sizeof(ones[0])); i++) {
+        float* values = stream(ones[i]);
+        for (int j = 0; j < _paddedSize; j++) {
+            values[j] = 1.0f;
+        }
+    }
+}
+
+int TRSStreams::size() const
+{
+    return _size;
+}
+
+int TRSStreams::paddedSize() const
+{
+    return _paddedSize;
+}
+
+float* TRSStreams::stream(Component component)
+{
+    return &_data[component * _paddedSize];
+}
+
+const float* TRSStreams::stream(Component component) const
+{
+    return &_data[component * _paddedSize];
+}
+
+void TRSStreams::setTranslation(int channel, const glm::vec3 &start, const glm::vec3 &end, float factor)
+{
+    for (int i = 0; i < 3; i++) {
+        stream((Component)(T0X + i))[channel] = start[i];
+        stream((Component)(T1X + i))[channel] = end[i];
+    }
+    stream(T_FACTOR)[channel] = factor;
+}
+
+void TRSStreams::setRotation(int channel, const glm::vec4 &start, const glm::vec4 &end, float factor)
+{
+    for (int i = 0; i < 4; i++) {
+        stream((Component)(R0X + i))[channel] = start[i];
+        stream((Component)(R1X + i))[channel] = end[i];
+    }
+    stream(R_FACTOR)[channel] = factor;
+}
+
+void TRSStreams::setScaling(int channel, const glm::vec3 &start, const glm::vec3 &end, float factor)
+{
+    for (int i = 0; i < 3; i++) {
+        stream((Component)(S0X + i))[channel] = start[i];
+        stream((Component)(S1X + i))[channel] = end[i];
+    }
+    stream(S_FACTOR)[channel] = factor;
+}
+
+
+// The kernel is written once against these lane types, each holding one value per channel of the batch
+
+struct ScalarLanes {
+    typedef float Value;
+    static const int width = 1;
+    static Value load(const float* p) { return *p; }
+    static Value set1(float v) { return v; }
+    static Value add(Value a, Value b) { return a + b; }
+    static Value sub(Value a, Value b) { return a - b; }
+    static Value mul(Value a, Value b) { return a * b; }
+    static Value div(Value a, Value b) { return a / b; }
+    static Value sqrt(Value a) { return std::sqrt(a); }
+    // Negates b wherever a is negative
+    static Value flipSign(Value a, Value b) { return a < 0.0f ? -b : b; }
+    
+    // rows holds the 12 entries of the matrices, row by row
+    static void store(const Value rows[12], Affine3x4* out)
+    {
+        std::memcpy(out->m, rows, sizeof(float) * 12);
+    }
+};
+
+#ifdef POSE_KERNEL_SSE
+struct SSELanes {
+    typedef __m128 Value;
+    static const int width = 4;
+    static Value load(const float* p) { return _mm_loadu_ps(p); }
+    static Value set1(float v) { return _mm_set1_ps(v); }
+    static Value add(Value a, Value b) { return _mm_add_ps(a, b); }
+    static Value sub(Value a, Value b) { return _mm_sub_ps(a, b); }
+    static Value mul(Value a, Value b) { return _mm_mul_ps(a, b); }
+    static Value div(Value a, Value b) { return _mm_div_ps(a, b); }
+    static Value sqrt(Value a) { return _mm_sqrt_ps(a); }
+    static Value flipSign(Value a, Value b) { return _mm_xor_ps(b, _mm_and_ps(a, _mm_set1_ps(-0.0f))); }
+    
+    // Transposes each row from one matrix component per register to one matrix per register
+    static void storeRows(Value c0, Value c1, Value c2, Value c3, int row, Affine3x4* out)
+    {
+        _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+        _mm_storeu_ps(out[0].m[row], c0);
+        _mm_storeu_ps(out[1].m[row], c1);
+        _mm_storeu_ps(out[2].m[row], c2);
+        _mm_storeu_ps(out[3].m[row], c3);
+    }
+    
+    static void store(const Value rows[12], Affine3x4* out)
+    {
+        for (int r = 0; r < 3; r++) {
+            storeRows(rows[4 * r], rows[4 * r + 1], rows[4 * r + 2], rows[4 * r + 3], r, out);
+        }
+    }
+};
+#endif
+
+#ifdef POSE_KERNEL_AVX2
+struct AVXLanes {
+    typedef __m256 Value;
+    static const int width = 8;
+    static Value load(const float* p) { return _mm256_loadu_ps(p); }
+    static Value set1(float v) { return _mm256_set1_ps(v); }
+    static Value add(Value a, Value b) { return _mm256_add_ps(a, b); }
+    static Value sub(Value a, Value b) { return _mm256_sub_ps(a, b); }
+    static Value mul(Value a, Value b) { return _mm256_mul_ps(a, b); }
+    static Value div(Value a, Value b) { return _mm256_div_ps(a, b); }
+    static Value sqrt(Value a) { return _mm256_sqrt_ps(a); }
+    static Value flipSign(Value a, Value b) { return _mm256_xor_ps(b, _mm256_and_ps(a, _mm256_set1_ps(-0.0f))); }
+    
+    // The lower and upper halves are four matrices each
+    static void store(const Value rows[12], Affine3x4* out)
+    {
+        for (int r = 0; r < 3; r++) {
+            const Value* c = rows + 4 * r;
+            SSELanes::storeRows(_mm256_castps256_ps128(c[0]), _mm256_castps256_ps128(c[1]), _mm256_castps256_ps128(c[2]), _mm256_castps256_ps128(c[3]), r, out);
+            SSELanes::storeRows(_mm256_extractf128_ps(c[0], 1), _mm256_extractf128_ps(c[1], 1), _mm256_extractf128_ps(c[2], 1), _mm256_extractf128_ps(c[3], 1), r, out + 4);
+        }
+    }
+};
+#endif
+
+template <class Lanes>
+static inline typename Lanes::Value lerp(const TRSStreams &streams, TRSStreams::Component start, TRSStreams::Component end, typename Lanes::Value factor, int base)
+{
+    const typename Lanes::Value a = Lanes::load(streams.stream(start) + base);
+    const typename Lanes::Value b = Lanes::load(streams.stream(end) + base);
+    return Lanes::add(a, Lanes::mul(factor, Lanes::sub(b, a)));
+}
+
+template <class Lanes>
+static void composeTRSLanes(const TRSStreams &streams, Affine3x4* out)
+{
+    typedef typename Lanes::Value V;
+    typedef TRSStreams S;
+    
+    const V one = Lanes::set1(1.0f);
+    const V two = Lanes::set1(2.0f);
+    
+    for (int base = 0; base < streams.paddedSize(); base += Lanes::width) {
+        const V tf = Lanes::load(streams.stream(S::T_FACTOR) + base);
+        const V tx = lerp<Lanes>(streams, S::T0X, S::T1X, tf, base);
+        const V ty = lerp<Lanes>(streams, S::T0Y, S::T1Y, tf, base);
+        const V tz = lerp<Lanes>(streams, S::T0Z, S::T1Z, tf, base);
+        
+        const V sf = Lanes::load(streams.stream(S::S_FACTOR) + base);
+        const V sx = lerp<Lanes>(streams, S::S0X, S::S1X, sf, base);
+        const V sy = lerp<Lanes>(streams, S::S0Y, S::S1Y, sf, base);
+        const V sz = lerp<Lanes>(streams, S::S0Z, S::S1Z, sf, base);
+        
+        // Rotation: take the end quaternion on the same hemisphere as the start one, then lerp and normalize
+        const V ax = Lanes::load(streams.stream(S::R0X) + base);
+        const V ay = Lanes::load(streams.stream(S::R0Y) + base);
+        const V az = Lanes::load(streams.stream(S::R0Z) + base);
+        const V aw = Lanes::load(streams.stream(S::R0W) + base);
+        V bx = Lanes::load(streams.stream(S::R1X) + base);
+        V by = Lanes::load(streams.stream(S::R1Y) + base);
+        V bz = Lanes::load(streams.stream(S::R1Z) + base);
+        V bw = Lanes::load(streams.stream(S::R1W) + base);
+        
+        const V cosine = Lanes::add(Lanes::add(Lanes::mul(ax, bx), Lanes::mul(ay, by)), Lanes::add(Lanes::mul(az, bz), Lanes::mul(aw, bw)));
+        bx = Lanes::flipSign(cosine, bx);
+        by = Lanes::flipSign(cosine, by);
+        bz = Lanes::flipSign(cosine, bz);
+        bw = Lanes::flipSign(cosine, bw);
+        
+        const V rf = Lanes::load(streams.stream(S::R_FACTOR) + base);
+        V qx = Lanes::add(ax, Lanes::mul(rf, Lanes::sub(bx, ax)));
+        V qy = Lanes::add(ay, Lanes::mul(rf, Lanes::sub(by, ay)));
+        V qz = Lanes::add(az, Lanes::mul(rf, Lanes::sub(bz, az)));
+        V qw = Lanes::add(aw, Lanes::mul(rf, Lanes::sub(bw, aw)));
+        
+        const V lengthSquared = Lanes::add(Lanes::add(Lanes::mul(qx, qx), Lanes::mul(qy, qy)), Lanes::add(Lanes::mul(qz, qz), Lanes::mul(qw, qw)));
+        const V inverseLength = Lanes::div(one, Lanes::sqrt(lengthSquared));
+        qx = Lanes::mul(qx, inverseLength);
+        qy = Lanes::mul(qy, inverseLength);
+        qz = Lanes::mul(qz, inverseLength);
+        qw = Lanes::mul(qw, inverseLength);
+        
+        // Rotation matrix (same layout as aiQuaternion::GetMatrix) with its columns multiplied by the scale
+        const V xx = Lanes::mul(qx, qx), yy = Lanes::mul(qy, qy), zz = Lanes::mul(qz, qz);
+        const V xy = Lanes::mul(qx, qy), xz = Lanes::mul(qx, qz), yz = Lanes::mul(qy, qz);
+        const V wx = Lanes::mul(qw, qx), wy = Lanes::mul(qw, qy), wz = Lanes::mul(qw, qz);
+        
+        V rows[12];
+        rows[0]  = Lanes::mul(Lanes::sub(one, Lanes::mul(two, Lanes::add(yy, zz))), sx);
+        rows[1]  = Lanes::mul(Lanes::mul(two, Lanes::sub(xy, wz)), sy);
+        rows[2]  = Lanes::mul(Lanes::mul(two, Lanes::add(xz, wy)), sz);
+        rows[3]  = tx;
+        rows[4]  = Lanes::mul(Lanes::mul(two, Lanes::add(xy, wz)), sx);
+        rows[5]  = Lanes::mul(Lanes::sub(one, Lanes::mul(two, Lanes::add(xx, zz))), sy);
+        rows[6]  = Lanes::mul(Lanes::mul(two, Lanes::sub(yz, wx)), sz);
+        rows[7]  = ty;
+        rows[8]  = Lanes::mul(Lanes::mul(two, Lanes::sub(xz, wy)), sx);
+        rows[9]  = Lanes::mul(Lanes::mul(two, Lanes::add(yz, wx)), sy);
+        rows[10] = Lanes::mul(Lanes::sub(one, Lanes::mul(two, Lanes::add(xx, yy))), sz);
+        rows[11] = tz;
+        
+        Lanes::store(rows, out + base);
+    }
+}
+
+void composeTRS(const TRSStreams &streams, Affine3x4* out)
+{
+#if defined(POSE_KERNEL_AVX2)
+    composeTRSLanes<AVXLanes>(streams, out);
+#elif defined(POSE_KERNEL_SSE)
+    composeTRSLanes<SSELanes>(streams, out);
+#else
+    composeTRSLanes<ScalarLanes>(streams, out);
+#endif
+}
+
+const char* poseKernelName()
+{
+#if defined(POSE_KERNEL_AVX2)
+    return "AVX2";
+#elif defined(POSE_KERNEL_SSE)
+    return "SSE2";
+#else
+    return "scalar";
+#endif
+}
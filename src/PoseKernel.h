@@ -0,0 +1,81 @@
+///
+///  PoseKernel.h
+///
+///  \brief Batch math for pose evaluation. Keyframe pairs of all animated channels are stored in structure-of-arrays
+///         streams so that the interpolation and the TRS to matrix composition run several channels per SIMD
+///         instruction (AVX2 when compiled with it, SSE2 on x86, plain C++ otherwise). Poses are kept as 3x4
+///         affine matrices, which is all a bone transform needs.
+///
+
+#ifndef PoseKernel_hpp
+#define PoseKernel_hpp
+
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+// Streams are padded to a multiple of the widest SIMD path so every instruction set can process full batches
+#define POSE_KERNEL_PADDING 8
+
+// Affine transform stored as three rows. Column 3 is the translation, the implied fourth row is (0, 0, 0, 1).
+struct Affine3x4 {
+    float m[3][4];
+};
+
+Affine3x4 toAffine(const glm::mat4 &matrix);
+glm::mat4 toMat4(const Affine3x4 &affine);
+
+// out = a * b. out may alias a or b.
+void multiplyAffine(const Affine3x4 &a, const Affine3x4 &b, Affine3x4 &out);
+
+// Rigid transform as a unit dual quaternion, both parts stored as (x, y, z, w)
+struct DualQuaternion {
+    glm::vec4 real;     // rotation
+    glm::vec4 dual;     // half the translation times the rotation
+};
+
+// Rotation and translation of affine. Scaling is dropped, dual quaternions cannot represent it.
+DualQuaternion toDualQuaternion(const Affine3x4 &affine);
+
+// Start and end keys of translation, rotation and scaling plus the interpolation factor of each track, for a batch of channels
+class TRSStreams
+{
+public:
+    
+    enum Component {
+        T0X, T0Y, T0Z, T1X, T1Y, T1Z, T_FACTOR,
+        R0X, R0Y, R0Z, R0W, R1X, R1Y, R1Z, R1W, R_FACTOR,
+        S0X, S0Y, S0Z, S1X, S1Y, S1Z, S_FACTOR,
+        NUM_COMPONENTS
+    };
+    
+    TRSStreams();
+    
+    // Sets the number of channels. All channels, including the padding, start as the identity transform.
+    void resize(int size);
+    
+    int size() const;
+    int paddedSize() const;
+    
+    float* stream(Component component);
+    const float* stream(Component component) const;
+    
+    void setTranslation(int channel, const glm::vec3 &start, const glm::vec3 &end, float factor);
+    void setRotation(int channel, const glm::vec4 &start, const glm::vec4 &end, float factor);   // quaternions as (x, y, z, w)
+    void setScaling(int channel, const glm::vec3 &start, const glm::vec3 &end, float factor);
+    
+private:
+    
+    int _size;
+    int _paddedSize;
+    std::vector<float> _data;
+};
+
+// Lerps translation and scaling, nlerps rotation along the shortest arc and writes translation * rotation * scaling
+// for every channel. out must hold streams.paddedSize() matrices.
+void composeTRS(const TRSStreams &streams, Affine3x4* out);
+
+// Name of the instruction set composeTRS was compiled for
+const char* poseKernelName();
+
+#endif /* PoseKernel_hpp */
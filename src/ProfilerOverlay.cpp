@@ -0,0 +1,215 @@
+//
+//  ProfilerOverlay.cpp
+//
+
+#include "ProfilerOverlay.h"
+
+#include <fontstash.h>
+
+#include <cstdio>
+#include <iostream>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+
+// Size of the glyph atlas, grown by fontstash when it fills up
+static const int ATLAS_SIZE = 512;
+
+// fontstash colors hold red in the lowest byte
+static unsigned int rgba(unsigned char r, unsigned char g, unsigned char b, unsigned char a)
+{
+    return r | (g << 8) | (b << 16) | ((unsigned int)a << 24);
+}
+
+ProfilerOverlay::ProfilerOverlay(const std::string &fontFile, const std::string &vertexFile, const std::string &fragmentFile, float fontSize) :
+    _fons(nullptr), _font(FONS_INVALID), _fontSize(fontSize), _texture(0), _textureWidth(0), _textureHeight(0), _vao(0), _vbo(0)
+{
+    FONSparams params;
+    params.width = ATLAS_SIZE;
+    params.height = ATLAS_SIZE;
+    params.flags = FONS_ZERO_TOPLEFT;
+    params.userPtr = this;
+    params.renderCreate = renderCreate;
+    params.renderResize = renderResize;
+    params.renderUpdate = renderUpdate;
+    params.renderDraw = renderDraw;
+    params.renderDelete = renderDelete;
+    _fons = fonsCreateInternal(&params);
+    if (_fons) {
+        _font = fonsAddFont(_fons, "overlay", fontFile.c_str());
+    }
+    if (_font == FONS_INVALID) {
+        std::cout << "Could not load font " << fontFile << ", the profiler overlay is disabled" << std::endl;
+        return;
+    }
+    
+    _shader.compileShader(vertexFile.c_str(), basicgraphics::GLSLShader::VERTEX);
+    _shader.compileShader(fragmentFile.c_str(), basicgraphics::GLSLShader::FRAGMENT);
+    _shader.link();
+    
+    glGenVertexArrays(1, &_vao);
+    glGenBuffers(1, &_vbo);
+}
+
+ProfilerOverlay::~ProfilerOverlay()
+{
+    if (_fons) {
+        fonsDeleteInternal(_fons);
+    }
+    if (_vbo) {
+        glDeleteBuffers(1, &_vbo);
+    }
+    if (_vao) {
+        glDeleteVertexArrays(1, &_vao);
+    }
+}
+
+bool ProfilerOverlay::isLoaded() const
+{
+    return _font != FONS_INVALID;
+}
+
+void ProfilerOverlay::draw(const FrameProfiler &profiler, float width, float height)
+{
+    if (!isLoaded()) {
+        return;
+    }
+    
+    // Text goes over everything and blends into it
+    const GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    const GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    
+    _shader.use();
+    _shader.setUniform("projection_mat", glm::ortho(0.0f, width, height, 0.0f, -1.0f, 1.0f));
+    _shader.setUniform("fontAtlas", 0);
+    
+    fonsClearState(_fons);
+    fonsSetFont(_fons, _font);
+    fonsSetSize(_fons, _fontSize);
+    fonsSetAlign(_fons, FONS_ALIGN_LEFT | FONS_ALIGN_TOP);
+    float lineHeight = 0.0f;
+    fonsVertMetrics(_fons, nullptr, nullptr, &lineHeight);
+    
+    const float x = 10.0f;
+    float y = 10.0f;
+    char line[256];
+    std::snprintf(line, sizeof(line), "%-18s %8s %8s %8s %8s", "ms", "last", "mean", "min", "max");
+    drawLine(line, x, y, rgba(255, 255, 255, 255));
+    y += lineHeight;
+    
+    for (int gpu = 0; gpu < 2; gpu++) {
+        const std::vector<std::string> timers = gpu ? profiler.getGpuTimers() : profiler.getCpuTimers();
+        for (const std::string &timer : timers) {
+            const FrameProfiler::Stats stats = gpu ? profiler.getGpuStats(timer) : profiler.getCpuStats(timer);
+            std::snprintf(line, sizeof(line), "%s %-14s %8.2f %8.2f %8.2f %8.2f", gpu ? "gpu" : "cpu", timer.c_str(),
+                          stats.last, stats.mean, stats.min, stats.max);
+            drawLine(line, x, y, gpu ? rgba(140, 220, 255, 255) : rgba(255, 230, 140, 255));
+            y += lineHeight;
+        }
+    }
+    if (profiler.isTracing()) {
+        drawLine("recording trace", x, y, rgba(255, 90, 90, 255));
+    }
+    
+    glBindVertexArray(0);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    if (cullFace) {
+        glEnable(GL_CULL_FACE);
+    }
+    if (!blend) {
+        glDisable(GL_BLEND);
+    }
+}
+
+// Draws text over a darker copy one pixel down and right, so that it stays readable over light parts of the scene
+void ProfilerOverlay::drawLine(const std::string &text, float x, float y, unsigned int color)
+{
+    fonsSetColor(_fons, rgba(0, 0, 0, 200));
+    fonsDrawText(_fons, x + 1.0f, y + 1.0f, text.c_str(), nullptr);
+    fonsSetColor(_fons, color);
+    fonsDrawText(_fons, x, y, text.c_str(), nullptr);
+}
+
+int ProfilerOverlay::renderCreate(void* userPtr, int width, int height)
+{
+    ProfilerOverlay* overlay = (ProfilerOverlay*)userPtr;
+    if (overlay->_texture) {
+        glDeleteTextures(1, &overlay->_texture);
+    }
+    glGenTextures(1, &overlay->_texture);
+    glBindTexture(GL_TEXTURE_2D, overlay->_texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    overlay->_textureWidth = width;
+    overlay->_textureHeight = height;
+    return 1;
+}
+
+int ProfilerOverlay::renderResize(void* userPtr, int width, int height)
+{
+    // fontstash uploads the whole atlas again after a resize
+    return renderCreate(userPtr, width, height);
+}
+
+// data is the whole atlas, of which the rows and columns in rect changed
+void ProfilerOverlay::renderUpdate(void* userPtr, int* rect, const unsigned char* data)
+{
+    ProfilerOverlay* overlay = (ProfilerOverlay*)userPtr;
+    glBindTexture(GL_TEXTURE_2D, overlay->_texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, overlay->_textureWidth);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect[0]);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, rect[1]);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, rect[0], rect[1], rect[2] - rect[0], rect[3] - rect[1], GL_RED, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+}
+
+// Positions, texture coordinates and colors are copied one after the other into the buffer, which is orphaned on
+// every call so that the previous batch can still be drawing
+void ProfilerOverlay::renderDraw(void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int numVertices)
+{
+    ProfilerOverlay* overlay = (ProfilerOverlay*)userPtr;
+    const size_t positionBytes = numVertices * 2 * sizeof(float);
+    const size_t colorBytes = numVertices * sizeof(unsigned int);
+    
+    glBindVertexArray(overlay->_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, overlay->_vbo);
+    glBufferData(GL_ARRAY_BUFFER, 2 * positionBytes + colorBytes, nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, positionBytes, verts);
+    glBufferSubData(GL_ARRAY_BUFFER, positionBytes, positionBytes, tcoords);
+    glBufferSubData(GL_ARRAY_BUFFER, 2 * positionBytes, colorBytes, colors);
+    
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)positionBytes);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(unsigned int), (void*)(2 * positionBytes));
+    
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, overlay->_texture);
+    glDrawArrays(GL_TRIANGLES, 0, numVertices);
+}
+
+void ProfilerOverlay::renderDelete(void* userPtr)
+{
+    ProfilerOverlay* overlay = (ProfilerOverlay*)userPtr;
+    if (overlay->_texture) {
+        glDeleteTextures(1, &overlay->_texture);
+        overlay->_texture = 0;
+    }
+}
@@ -0,0 +1,59 @@
+///
+///  ProfilerOverlay.h
+///
+///  \brief Draws the rolling statistics of a FrameProfiler as text over the scene. Glyphs are rasterized by
+///         fontstash into an atlas texture and drawn as one batch of textured quads per call of fontstash.
+///
+
+#ifndef ProfilerOverlay_hpp
+#define ProfilerOverlay_hpp
+
+#include <string>
+#include "FrameProfiler.h"
+#include "GLSLProgram.h"
+
+struct FONScontext;
+
+class ProfilerOverlay
+{
+public:
+    
+    // Loads the font file and the text shaders. Needs a current GL context.
+    ProfilerOverlay(const std::string &fontFile, const std::string &vertexFile, const std::string &fragmentFile, float fontSize = 16.0f);
+    
+    ~ProfilerOverlay();
+    
+    // False if the font could not be loaded, draw then does nothing
+    bool isLoaded() const;
+    
+    // Writes the last, mean, min and max time of every timer of profiler in the top left corner of a viewport of
+    // width by height pixels
+    void draw(const FrameProfiler &profiler, float width, float height);
+
+private:
+    
+    ProfilerOverlay(const ProfilerOverlay&) = delete;
+    ProfilerOverlay& operator=(const ProfilerOverlay&) = delete;
+    
+    FONScontext* _fons;
+    int _font;
+    float _fontSize;
+    basicgraphics::GLSLProgram _shader;
+    
+    GLuint _texture;            // glyph atlas
+    int _textureWidth;
+    int _textureHeight;
+    GLuint _vao;
+    GLuint _vbo;
+    
+    void drawLine(const std::string &text, float x, float y, unsigned int color);
+    
+    // fontstash render callbacks, with the overlay as user pointer
+    static int renderCreate(void* userPtr, int width, int height);
+    static int renderResize(void* userPtr, int width, int height);
+    static void renderUpdate(void* userPtr, int* rect, const unsigned char* data);
+    static void renderDraw(void* userPtr, const float* verts, const float* tcoords, const unsigned int* colors, int numVertices);
+    static void renderDelete(void* userPtr);
+};
+
+#endif /* ProfilerOverlay_hpp */
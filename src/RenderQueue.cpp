@@ -0,0 +1,158 @@
+//
+//  RenderQueue.cpp
+//
+
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+
+static basicgraphics::GLSLProgram* getProgram(const RenderQueue::Item &item)
+{
+    return &item.shaders->getVariant(item.numInfluences, item.mode);
+}
+
+static GLuint getFirstTexture(const RenderQueue::Item &item)
+{
+    const std::vector<std::shared_ptr<basicgraphics::Texture> > &textures = item.mesh->getTextures();
+    return textures.empty() ? 0 : textures[0]->getID();
+}
+
+// Program changes cost the most, then textures, then vertex arrays
+static bool drawsBefore(const RenderQueue::Item &a, const RenderQueue::Item &b)
+{
+    const basicgraphics::GLSLProgram* programA = getProgram(a);
+    const basicgraphics::GLSLProgram* programB = getProgram(b);
+    if (programA != programB) {
+        return programA < programB;
+    }
+    const GLuint textureA = getFirstTexture(a);
+    const GLuint textureB = getFirstTexture(b);
+    if (textureA != textureB) {
+        return textureA < textureB;
+    }
+    const GLuint vaoA = a.mesh->getVAOID();
+    const GLuint vaoB = b.mesh->getVAOID();
+    if (vaoA != vaoB) {
+        return vaoA < vaoB;
+    }
+    if (a.instanceListOffset != b.instanceListOffset) {
+        return a.instanceListOffset < b.instanceListOffset;
+    }
+    return a.instancesOffset < b.instancesOffset;
+}
+
+RenderQueue::RenderQueue() : _program(nullptr), _vao(0)
+{
+}
+
+void RenderQueue::add(const Item &item)
+{
+    assert(item.mesh->getSharedBuffers());
+    if (item.mesh->isTranslucent()) {
+        _translucent.push_back(item);
+    }
+    else {
+        _opaque.push_back(item);
+    }
+}
+
+int RenderQueue::getNumItems() const
+{
+    return (int)(_opaque.size() + _translucent.size());
+}
+
+void RenderQueue::flush(const glm::mat4 &view)
+{
+    _stats = Stats();
+    _program = nullptr;
+    _vao = 0;
+    _materials.clear();
+    
+    std::stable_sort(_opaque.begin(), _opaque.end(), drawsBefore);
+    for (const Item &item : _opaque) {
+        submit(item);
+    }
+    
+    if (!_translucent.empty()) {
+        // Farthest first. The camera looks down -z, so those have the smallest z.
+        std::vector< std::pair<float, int> > order;
+        for (int i = 0; i < _translucent.size(); i++) {
+            order.push_back(std::make_pair((view * glm::vec4(_translucent[i].position, 1.0f)).z, i));
+        }
+        std::stable_sort(order.begin(), order.end(), [](const std::pair<float, int> &a, const std::pair<float, int> &b) {
+            return a.first < b.first;
+        });
+        
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        for (const std::pair<float, int> &entry : order) {
+            submit(_translucent[entry.second]);
+        }
+        glDepthMask(GL_TRUE);
+        glBlendFunc(GL_ONE, GL_ZERO);
+        glDisable(GL_BLEND);
+    }
+    
+    // Reset state
+    glBindVertexArray(0);
+    for (int i = 0; i < _textures.size(); i++) {
+        if (_textures[i] != 0) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+    }
+    glActiveTexture(GL_TEXTURE0);
+    _textures.clear();
+    
+    _opaque.clear();
+    _translucent.clear();
+}
+
+const RenderQueue::Stats& RenderQueue::getStats() const
+{
+    return _stats;
+}
+
+void RenderQueue::submit(const Item &item)
+{
+    item.shaders->setInstancesOffset(item.instancesOffset, item.instanceListOffset);
+    basicgraphics::GLSLProgram* program = getProgram(item);
+    if (program != _program) {
+        item.shaders->use(item.numInfluences, item.mode);
+        _program = program;
+        _stats.programChanges++;
+    }
+    else {
+        item.shaders->applyUniforms(item.numInfluences, item.mode);
+    }
+    
+    const std::vector<std::shared_ptr<basicgraphics::Texture> > &textures = item.mesh->getTextures();
+    if (_textures.size() < textures.size()) {
+        _textures.resize(textures.size(), 0);
+    }
+    for (int i = 0; i < textures.size(); i++) {
+        if (_textures[i] != textures[i]->getID()) {
+            textures[i]->bind(i);
+            _textures[i] = textures[i]->getID();
+            _stats.textureBinds++;
+        }
+    }
+    
+    const BoneMesh* &material = _materials[program];
+    if (!material || !material->hasSameMaterial(*item.mesh) || !(material->getVertexFormat() == item.mesh->getVertexFormat())) {
+        item.mesh->setMaterialUniforms(*program);
+        material = item.mesh;
+        _stats.materialChanges++;
+    }
+    
+    if (item.mesh->getVAOID() != _vao) {
+        _vao = item.mesh->getVAOID();
+        glBindVertexArray(_vao);
+        _stats.vaoBinds++;
+    }
+    
+    item.mesh->getSharedBuffers()->submit(item.mesh->getPrimitiveType(), item.firstCommand, item.numCommands, item.numInstances);
+    _stats.draws++;
+}
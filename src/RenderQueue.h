@@ -0,0 +1,74 @@
+///
+///  RenderQueue.h
+///
+///  \brief Collects the draws of every model in a view and submits them in the order that changes the least GL
+///         state: opaque draws sorted by program, textures and VAO, then translucent draws back to front, blended
+///         over the opaque geometry with depth writes off. The state set last is tracked, so that calls which would
+///         not change anything are skipped.
+///
+
+#ifndef RenderQueue_hpp
+#define RenderQueue_hpp
+
+#include <map>
+#include <vector>
+#include "BoneMesh.h"
+#include "MeshBuffers.h"
+#include "SkinningShaders.h"
+
+
+class RenderQueue
+{
+public:
+    
+    // Commands of a mesh's shared buffers drawn with its material by one skinning variant, for numInstances
+    // instances whose records start at instancesOffset, or are listed at instanceListOffset unless it is -1
+    struct Item {
+        SkinningShaders* shaders;
+        SkinningMode mode;
+        int numInfluences;
+        GLint instancesOffset;
+        GLint instanceListOffset;
+        int numInstances;
+        const BoneMesh* mesh;
+        int firstCommand;
+        int numCommands;
+        glm::vec3 position;             // in world space, orders translucent items
+    };
+    
+    // What the last flush submitted and changed
+    struct Stats {
+        int draws = 0;
+        int programChanges = 0;
+        int textureBinds = 0;
+        int vaoBinds = 0;
+        int materialChanges = 0;
+    };
+    
+    RenderQueue();
+    
+    void add(const Item &item);
+    int getNumItems() const;
+    
+    // Draws every item added since the last flush, translucent ones sorted by their distance along view, then
+    // empties the queue. GL is left as it was found: no blending, depth writes on, no VAO and no textures bound.
+    void flush(const glm::mat4 &view);
+    
+    const Stats& getStats() const;
+
+private:
+    
+    std::vector<Item> _opaque;
+    std::vector<Item> _translucent;
+    
+    // State set by the flush in progress
+    basicgraphics::GLSLProgram* _program;
+    GLuint _vao;
+    std::vector<GLuint> _textures;      // per texture unit
+    std::map<const basicgraphics::GLSLProgram*, const BoneMesh*> _materials;   // uniforms last set on each program
+    Stats _stats;
+    
+    void submit(const Item &item);
+};
+
+#endif /* RenderQueue_hpp */
@@ -0,0 +1,84 @@
+//
+//  Skeleton.cpp
+//
+
+#include "Skeleton.h"
+
+
+Skeleton::Skeleton()
+{
+}
+
+void Skeleton::build(const aiNode* root, const std::map<std::string, int> &boneMapping)
+{
+    _nodes.clear();
+    _names.clear();
+    addNode(root, -1, boneMapping);
+}
+
+// Appends node and then its subtree, so that the parent index is always known when a child is added
+void Skeleton::addNode(const aiNode* node, int parent, const std::map<std::string, int> &boneMapping)
+{
+    Node flat;
+    flat.parent = parent;
+    flat.localTransform = toAffine(aiMatrix4x4ToGlm(&node->mTransformation));
+    
+    std::map<std::string, int>::const_iterator bone = boneMapping.find(node->mName.data);
+    flat.boneIndex = bone != boneMapping.end() ? bone->second : -1;
+    
+    const int index = (int)_nodes.size();
+    _nodes.push_back(flat);
+    _names.push_back(node->mName.data);
+    
+    for (uint i = 0; i < node->mNumChildren; i++) {
+        addNode(node->mChildren[i], index, boneMapping);
+    }
+}
+
+void Skeleton::cook(CookedWriter &writer) const
+{
+    writer.writeArray(_nodes);
+    for (const std::string &name : _names) {
+        writer.writeString(name);
+    }
+}
+
+bool Skeleton::load(CookedReader &reader, int numBones)
+{
+    reader.readArray(_nodes);
+    _names.resize(_nodes.size());
+    for (std::string &name : _names) {
+        name = reader.readString();
+    }
+    
+    for (int i = 0; i < (int)_nodes.size(); i++) {
+        if (_nodes[i].parent < -1 || _nodes[i].parent >= i || _nodes[i].boneIndex < -1 || _nodes[i].boneIndex >= numBones) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int Skeleton::getNumNodes() const
+{
+    return (int)_nodes.size();
+}
+
+const Skeleton::Node& Skeleton::getNode(int index) const
+{
+    return _nodes[index];
+}
+
+const std::string& Skeleton::getNodeName(int index) const
+{
+    return _names[index];
+}
+
+void Skeleton::localToGlobal(const Affine3x4* local, const Affine3x4 &rootTransform, Affine3x4* global) const
+{
+    const int numNodes = (int)_nodes.size();
+    for (int i = 0; i < numNodes; i++) {
+        const int parent = _nodes[i].parent;
+        multiplyAffine(parent < 0 ? rootTransform : global[parent], local[i], global[i]);
+    }
+}
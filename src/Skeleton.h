@@ -0,0 +1,85 @@
+///
+///  Skeleton.h
+///
+///  \brief Flattened copy of a model's node hierarchy. Nodes are stored in a contiguous array in which every
+///         parent comes before its children, so poses can be evaluated with a single linear loop instead of
+///         recursing through the aiNode tree.
+///
+
+#ifndef Skeleton_hpp
+#define Skeleton_hpp
+
+#include <map>
+#include <string>
+#include <vector>
+#include <assimp/scene.h>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include "PoseKernel.h"
+#include "CookedAsset.h"
+
+
+class Skeleton
+{
+public:
+    
+    struct Node {
+        int parent;                 // index of the parent node, -1 for the root. Always smaller than the node's own index
+        int boneIndex;              // index into the bone palette, -1 if the node does not deform any vertex
+        Affine3x4 localTransform;   // bind transform relative to the parent
+    };
+    
+    Skeleton();
+    
+    // Flattens the tree under root in pre-order. boneMapping maps bone names to palette indices.
+    void build(const aiNode* root, const std::map<std::string, int> &boneMapping);
+    
+    // Writes the nodes and their names to a cooked asset, load reads them back. load returns false if a node comes
+    // before its parent or deforms a bone outside [0, numBones).
+    void cook(CookedWriter &writer) const;
+    bool load(CookedReader &reader, int numBones);
+    
+    int getNumNodes() const;
+    const Node& getNode(int index) const;
+    const std::string& getNodeName(int index) const;
+    
+    // Multiplies every local transform by the global transform of its parent, and the root by rootTransform.
+    // local and global hold getNumNodes() matrices.
+    void localToGlobal(const Affine3x4* local, const Affine3x4 &rootTransform, Affine3x4* global) const;
+    
+private:
+    
+    std::vector<Node> _nodes;
+    std::vector<std::string> _names;   // kept apart from _nodes so that evaluation does not pull them into the cache
+    
+    void addNode(const aiNode* node, int parent, const std::map<std::string, int> &boneMapping);
+};
+
+// Assimp matrices are row major, glm ones column major
+inline glm::mat4 aiMatrix4x4ToGlm(const aiMatrix4x4* from)
+{
+    glm::mat4 to;
+    
+    
+    to[0][0] = (float)from->a1; to[0][1] = (float)from->b1;  to[0][2] = (float)from->c1; to[0][3] = (float)from->d1;
+    to[1][0] = (float)from->a2; to[1][1] = (float)from->b2;  to[1][2] = (float)from->c2; to[1][3] = (float)from->d2;
+    to[2][0] = (float)from->a3; to[2][1] = (float)from->b3;  to[2][2] = (float)from->c3; to[2][3] = (float)from->d3;
+    to[3][0] = (float)from->a4; to[3][1] = (float)from->b4;  to[3][2] = (float)from->c4; to[3][3] = (float)from->d4;
+    
+    return to;
+}
+
+inline glm::mat4 aiMatrix3x3ToGlm(const aiMatrix3x3* from)
+{
+    glm::mat4 to;
+    
+    
+    to[0][0] = (float)from->a1; to[0][1] = (float)from->b1;  to[0][2] = (float)from->c1; to[0][3] = 0.0f;
+    to[1][0] = (float)from->a2; to[1][1] = (float)from->b2;  to[1][2] = (float)from->c2; to[1][3] = 0.0f;
+    to[2][0] = (float)from->a3; to[2][1] = (float)from->b3;  to[2][2] = (float)from->c3; to[2][3] = 0.0f;
+    to[3][0] = 0.0f;            to[3][1] = 0.0f;             to[3][2] = 0.0f;            to[3][3] = 1.0f;
+    
+    return to;
+}
+
+#endif /* Skeleton_hpp */
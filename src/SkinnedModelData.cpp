@@ -0,0 +1,749 @@
+//
+//  SkinnedModelData.cpp
+//
+//  Created by Trung Nguyen on 12/12/2018.
+//
+
+#include "SkinnedModelData.h"
+
+#include "glm/ext.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+
+ProgressReporter::ProgressReporter(bool printToConsole) : _printToConsole(printToConsole), _progress(0.0f)
+{
+    _firstUpdate = true;
+}
+
+ProgressReporter::~ProgressReporter()
+{
+}
+
+void ProgressReporter::reset()
+{
+    _firstUpdate = true;
+    _progress = 0.0f;
+}
+
+float ProgressReporter::getProgress() const
+{
+    return _progress;
+}
+
+bool ProgressReporter::Update(float percentage)
+{
+    if (percentage >= 0.0f) {
+        _progress = percentage;
+    }
+    if (!_printToConsole) {
+        return true;
+    }
+    
+    if (_firstUpdate) {
+        std::cout << std::endl << "Importing Progress:       ";
+        _firstUpdate = false;
+    }
+    std::cout << "\b\b\b\b\b" << std::setfill(' ') << std::setw(4) << percentage << "%";
+    flush(std::cout);
+    return true;
+}
+
+// Assimp has a single global logger. It is created by the first asset alive and killed with the last one, so that
+// assets imported on other threads do not lose it while they are loading.
+static std::mutex loggerMutex;
+static int loggerUsers = 0;
+
+static void acquireLogger()
+{
+    std::lock_guard<std::mutex> lock(loggerMutex);
+    if (loggerUsers++ == 0) {
+        Assimp::Logger::LogSeverity severity = Assimp::Logger::NORMAL;
+        // Create a logger instance for Console Output
+        Assimp::DefaultLogger::create("", severity, aiDefaultLogStream_STDOUT);
+    }
+}
+
+static void releaseLogger()
+{
+    std::lock_guard<std::mutex> lock(loggerMutex);
+    if (--loggerUsers == 0) {
+        Assimp::DefaultLogger::kill();
+    }
+}
+
+
+SkinnedModelData::SkinnedModelData(const std::string &filename, const double scale, const ImportSettings &settings, ProgressReporter* reporter) :
+    _scale(scale), scene(nullptr), _loaded(false), _released(false), _settings(settings)
+{
+    // Assimp is thread safe as long as every thread uses its own importer
+    acquireLogger();
+    std::fill(_lodErrors, _lodErrors + NUM_LODS, 0.0f);
+    
+    int numIndices = 0;
+    
+    if (isCookedAsset(filename)) {
+        loadCooked(filename, scale);
+    }
+    else {
+        importMesh(filename, numIndices, scale, reporter);
+    }
+}
+
+SkinnedModelData::SkinnedModelData(const aiScene* importedScene, const std::string &name, const ImportSettings &settings) :
+    _scale(1.0), scene(nullptr), _loaded(false), _released(false), _settings(settings)
+{
+    acquireLogger();
+    std::fill(_lodErrors, _lodErrors + NUM_LODS, 0.0f);
+    
+    importScene(importedScene, name, 1.0);
+}
+
+SkinnedModelData::~SkinnedModelData()
+{
+    // Kill it after the work is done
+    if (_importer) {
+        _importer->FreeScene();
+    }
+    releaseLogger();
+}
+
+bool SkinnedModelData::isLoaded() const
+{
+    return _loaded;
+}
+
+int SkinnedModelData::selectLod(const LodView &view, const glm::vec3 &position, float scale) const
+{
+    if (view.pixelsPerUnit <= 0.0f) {
+        return 0;
+    }
+    const float distance = glm::length(position - view.eye);
+    for (int lod = NUM_LODS - 1; lod > 0; lod--) {
+        if (_lodErrors[lod] * scale * view.pixelsPerUnit <= view.maxErrorPixels * distance) {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+float SkinnedModelData::getLodError(int lod) const
+{
+    return _lodErrors[lod];
+}
+
+LodView::LodView() : eye(0.0f), pixelsPerUnit(0.0f), maxErrorPixels(1.0f)
+{
+}
+
+LodView::LodView(const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight, float maxErrorPixels) :
+    eye(eye), pixelsPerUnit(projection[1][1] * viewportHeight * 0.5f), maxErrorPixels(maxErrorPixels)
+{
+}
+
+// Sorts the triangles by the largest variant among their vertices, so that each variant is drawn as one range of indices
+static std::vector<DrawRange> partitionTriangles(const std::vector<int> &variants, std::vector<int> &indices)
+{
+    std::vector<DrawRange> ranges;
+    if (indices.size() % 3 != 0) {
+        // Not only triangles, keep the single range of every influence
+        return ranges;
+    }
+    
+    std::vector<int> triangles[NUM_INFLUENCE_VARIANTS];
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        const int variant = std::max(variants[indices[t]], std::max(variants[indices[t + 1]], variants[indices[t + 2]]));
+        triangles[variant].insert(triangles[variant].end(), indices.begin() + t, indices.begin() + t + 3);
+    }
+    
+    indices.clear();
+    for (int v = 0; v < NUM_INFLUENCE_VARIANTS; v++) {
+        if (!triangles[v].empty()) {
+            DrawRange range = { getVariantInfluences(v), (int)indices.size(), (int)triangles[v].size() };
+            ranges.push_back(range);
+            indices.insert(indices.end(), triangles[v].begin(), triangles[v].end());
+        }
+    }
+    
+    return ranges;
+}
+
+// Prunes the influences of every vertex, then sorts the triangles by the largest influence count among their vertices
+// so that each count is drawn as one range of indices
+static std::vector<DrawRange> partitionByInfluences(std::vector<SkinnedVertex> &vertices, std::vector<int> &indices, float tolerance)
+{
+    std::vector<int> variants(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) {
+        variants[v] = getInfluenceVariant(vertices[v].PruneBoneData(tolerance));
+    }
+    
+    return partitionTriangles(variants, indices);
+}
+
+// Number of weights left in a pruned vertex, at least one
+static int countInfluences(const SkinnedVertex &vertex)
+{
+    int count = 1;
+    while (count < NUM_BONES_PER_VERTEX && vertex.weights[count] != 0.0f) {
+        count++;
+    }
+    return count;
+}
+
+// Simplifies the triangles of data into coarser levels of detail, each from the previous one, and skins each with at
+// most LOD_MAX_INFLUENCES of its level. Stops early once the simplifier cannot remove enough triangles.
+void SkinnedModelData::generateLods(MeshData &data) const
+{
+    const std::vector<SkinnedVertex> &vertices = data.importedVertices;
+    const int numTriangles = (int)data.importedIndices.size() / 3;
+    std::vector<int> influences(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++) {
+        influences[v] = countInfluences(vertices[v]);
+    }
+    
+    const std::vector<int>* source = &data.importedIndices;
+    float error = 0.0f;
+    for (int lod = 1; lod < NUM_LODS; lod++) {
+        MeshData::Lod level;
+        const int targetIndices = 3 * (int)(numTriangles * LOD_TRIANGLE_RATIOS[lod]);
+        error = std::max(error, simplifyMesh(vertices, *source, targetIndices, level.importedIndices));
+        if (level.importedIndices.empty() || level.importedIndices.size() > 0.9 * source->size()) {
+            break;
+        }
+        
+        // The shader renormalizes the weights a variant truncates
+        const int maxVariant = getInfluenceVariant(LOD_MAX_INFLUENCES[lod]);
+        std::vector<int> variants(vertices.size());
+        for (size_t v = 0; v < vertices.size(); v++) {
+            variants[v] = std::min(getInfluenceVariant(influences[v]), maxVariant);
+        }
+        level.drawRanges = partitionTriangles(variants, level.importedIndices);
+        if (_settings.optimizeMeshes) {
+            for (const DrawRange &range : level.drawRanges) {
+                optimizeVertexCache(&level.importedIndices[range.firstIndex], range.numIndices, (int)vertices.size());
+            }
+        }
+        level.error = error;
+        level.indices = nullptr;
+        level.numIndices = (int)level.importedIndices.size();
+        data.lods.push_back(std::move(level));
+        source = &data.lods.back().importedIndices;
+    }
+}
+
+// Reads the centers of rotation of a mesh from the cache file next to filename, or computes and caches them
+static void findCentersOfRotation(const std::string &filename, const std::vector<SkinnedVertex> &vertices, const std::vector<int> &indices,
+                                  float sigma, JobSystem &jobs, std::vector<glm::vec3> &centers)
+{
+    const SkinnedVertex* vertexData = vertices.empty() ? nullptr : &vertices[0];
+    const int* indexData = indices.empty() ? nullptr : &indices[0];
+    const uint64_t hash = hashSkinnedMesh(vertexData, (int)vertices.size(), indexData, (int)indices.size(), sigma);
+    
+    char hashString[17];
+    std::snprintf(hashString, sizeof(hashString), "%016llx", (unsigned long long)hash);
+    const std::string cacheFile = filename + "." + hashString + CENTERS_OF_ROTATION_EXTENSION;
+    
+    if (loadCentersOfRotation(cacheFile, hash, (int)vertices.size(), centers)) {
+        return;
+    }
+    
+    computeCentersOfRotation(vertexData, (int)vertices.size(), indexData, (int)indices.size(), sigma, jobs, centers);
+    
+    if (!saveCentersOfRotation(cacheFile, hash, centers)) {
+        std::cout << "Cannot write " << cacheFile << std::endl;
+    }
+}
+
+void SkinnedModelData::importMesh(const std::string &filename, int &numIndices, const double scale/*=1.0*/, ProgressReporter* reporter)
+{
+    if (_importer.get() == nullptr) {
+        _importer.reset(new Assimp::Importer());
+    }
+    
+    if (reporter != nullptr) {
+        _importer->SetProgressHandler(reporter);
+    }
+    scene = _importer->ReadFile(filename, aiProcess_Triangulate | aiProcess_GenNormals | aiProcess_FlipUVs);
+    if (reporter != nullptr) {
+        // The importer deletes the handler it holds, passing null hands reporter back to the caller
+        _importer->SetProgressHandler(nullptr);
+    }
+    
+    // If the import failed, report it
+    if (!scene || scene->mFlags == AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
+    {
+        Assimp::DefaultLogger::get()->info(_importer->GetErrorString());
+        return;
+    }
+    
+    importScene(scene, filename, scale);
+    
+    // Meshes and clips have been copied out of the scene, the keys in particular are much larger than their compressed form
+    _importer->FreeScene();
+}
+
+// Copies the meshes, skeleton and clips out of importedScene, whose file name names the cache of centers of rotation
+void SkinnedModelData::importScene(const aiScene* importedScene, const std::string &filename, const double scale)
+{
+    scene = importedScene;
+    
+    glm::mat4 scaleMat(1.0);
+    scaleMat[0][0] = scale;
+    scaleMat[1][1] = scale;
+    scaleMat[2][2] = scale;
+    
+    printf("aiScence has animations: %d\n", scene->HasAnimations());
+    
+    _globalInverseTransform = toAffine(glm::inverse(aiMatrix4x4ToGlm(&scene->mRootNode->mTransformation)));
+    this->processNode(scene->mRootNode, scene, scaleMat);
+    std::unique_ptr<JobSystem> jobs;
+    for (MeshData &data : _meshData) {
+        if (_settings.optimizeMeshes) {
+            MeshOptimizerStats stats;
+            stats.numVertices = (int)data.importedVertices.size();
+            stats.numTriangles = (int)data.importedIndices.size() / 3;
+            stats.acmrBefore = computeACMR(data.importedIndices.data(), (int)data.importedIndices.size(), stats.numVertices);
+            stats.numWeldedVertices = weldVertices(data.importedVertices, data.importedIndices);
+            _optimizerStats.push_back(stats);
+        }
+        data.drawRanges = partitionByInfluences(data.importedVertices, data.importedIndices, _settings.influenceTolerance);
+        if (_settings.optimizeMeshes && data.importedIndices.size() % 3 == 0) {
+            // Each range is drawn on its own, so its triangles are only reordered among themselves
+            const int numVertices = (int)data.importedVertices.size();
+            if (data.drawRanges.empty()) {
+                optimizeVertexCache(data.importedIndices.data(), (int)data.importedIndices.size(), numVertices);
+            }
+            for (const DrawRange &range : data.drawRanges) {
+                optimizeVertexCache(&data.importedIndices[range.firstIndex], range.numIndices, numVertices);
+            }
+            optimizeVertexFetch(data.importedVertices, data.importedIndices);
+            
+            MeshOptimizerStats &stats = _optimizerStats.back();
+            stats.acmrAfter = computeACMR(data.importedIndices.data(), (int)data.importedIndices.size(), (int)data.importedVertices.size());
+        }
+        if (_settings.generateLods && !data.drawRanges.empty()) {
+            generateLods(data);
+        }
+        if (_settings.centersOfRotation) {
+            if (!jobs) {
+                jobs.reset(new JobSystem());
+            }
+            findCentersOfRotation(filename, data.importedVertices, data.importedIndices, _settings.centerOfRotationSigma, *jobs, data.centersOfRotation);
+        }
+        data.numVertices = (int)data.importedVertices.size();
+        if (_settings.packVertices) {
+            // Bone IDs are only sized once every mesh has added its bones
+            data.vertexFormat = VertexFormat::packed((int)_boneOffset.size(), _settings.packedWeightType,
+                                                     _settings.octahedralNormals, _settings.halfTexCoords);
+            data.vertexFormat.pack(data.importedVertices.data(), data.numVertices, data.packedVertices);
+            std::vector<SkinnedVertex>().swap(data.importedVertices);
+            data.vertices = data.packedVertices.empty() ? nullptr : &data.packedVertices[0];
+        }
+        else {
+            data.vertices = data.importedVertices.empty() ? nullptr : &data.importedVertices[0];
+        }
+        data.indices = data.importedIndices.empty() ? nullptr : &data.importedIndices[0];
+        data.numIndices = (int)data.importedIndices.size();
+        for (MeshData::Lod &level : data.lods) {
+            level.indices = level.importedIndices.data();
+        }
+    }
+    
+    // Bones are only known once every mesh has been processed
+    bindAnimations();
+    computeLodErrors();
+    
+    scene = nullptr;
+    _loaded = true;
+}
+
+
+// Processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
+void SkinnedModelData::processNode(aiNode* node, const aiScene* scene, const glm::mat4 scaleMat)
+{
+    // Process each mesh located at the current node
+    for (unsigned i = 0; i < node->mNumMeshes; i++)
+    {
+        // The node object only contains indices to index the actual objects in the scene.
+        // The scene contains all the data, node is just to keep stuff organized (like relations between nodes).
+        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        this->_meshData.push_back(this->processMesh(mesh, scene, scaleMat));
+    }
+    // After we've processed all of the meshes (if any) we then recursively process each of the children nodes
+    for (unsigned i = 0; i < node->mNumChildren; i++)
+    {
+        this->processNode(node->mChildren[i], scene, scaleMat);
+    }
+
+}
+
+// Resolves every skeleton node to its channel in each animation, so that pose evaluation only deals with indices
+void SkinnedModelData::bindAnimations()
+{
+    _skeleton.build(scene->mRootNode, _boneMapping);
+    
+    const int numNodes = _skeleton.getNumNodes();
+    
+    _clips.resize(scene->mNumAnimations);
+    for (uint a = 0; a < scene->mNumAnimations; a++) {
+        const aiAnimation* pAnimation = scene->mAnimations[a];
+        
+        std::map<std::string, int> channelMapping;
+        for (uint c = 0; c < pAnimation->mNumChannels; c++) {
+            // Keep the first channel for a node, like the old linear search did
+            channelMapping.insert(std::make_pair(std::string(pAnimation->mChannels[c]->mNodeName.data), (int)c));
+        }
+        
+        Clip &clip = _clips[a];
+        clip.name = pAnimation->mName.C_Str();
+        clip.ticksPerSecond = pAnimation->mTicksPerSecond != 0 ? pAnimation->mTicksPerSecond : 25.0f;
+        clip.duration = pAnimation->mDuration;
+        clip.nodeSlots.assign(numNodes, -1);
+        
+        for (int i = 0; i < numNodes; i++) {
+            std::map<std::string, int>::const_iterator channel = channelMapping.find(_skeleton.getNodeName(i));
+            if (channel != channelMapping.end()) {
+                const aiNodeAnim* pNodeAnim = pAnimation->mChannels[channel->second];
+                clip.nodeSlots[i] = (int)clip.channels.size();
+                clip.channels.push_back(CompressedChannel(pNodeAnim, _settings.compression));
+                clip.nodes.push_back(i);
+            }
+        }
+    }
+}
+
+
+SkinnedModelData::MeshData SkinnedModelData::processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4 scaleMat)
+{
+    // Data to fill
+    MeshData data;
+    std::vector<SkinnedVertex> &cpuVertexArray = data.importedVertices;
+    std::vector<int> &cpuIndexArray = data.importedIndices;
+    
+    // Walk through each of the mesh's vertices
+    for (unsigned i = 0; i < mesh->mNumVertices; i++)
+    {
+        SkinnedVertex vertex;
+        
+        glm::vec4 position;
+        position.x = mesh->mVertices[i].x;
+        position.y = mesh->mVertices[i].y;
+        position.z = mesh->mVertices[i].z;
+        position.w = 1.0;
+        glm::vec3 normal;
+        normal.x = mesh->mNormals[i].x;
+        normal.y = mesh->mNormals[i].y;
+        normal.z = mesh->mNormals[i].z;
+        
+        vertex.position = (scaleMat * position);
+        vertex.normal = glm::normalize(normal);
+        
+        // Texture Coordinates
+        if (mesh->mTextureCoords[0]) {
+            vertex.texCoord0 = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+        }
+        else {
+            vertex.texCoord0 = glm::vec2(0.0f, 0.0f);
+        }
+        
+        cpuVertexArray.push_back(vertex);
+    }
+    
+    for (uint i = 0 ; i < mesh->mNumBones ; i++) {
+        int boneIndex = 0;
+        std::string boneName(mesh->mBones[i]->mName.data);
+        
+        if (_boneMapping.find(boneName) == _boneMapping.end()) {
+            boneIndex = (int)_boneOffset.size();
+            _boneMapping[boneName] = boneIndex;
+            
+            _boneOffset.push_back(toAffine(aiMatrix4x4ToGlm(&mesh->mBones[i]->mOffsetMatrix)));
+        }
+        else {
+            boneIndex = _boneMapping[boneName];
+        }
+        
+        for (uint j = 0 ; j < mesh->mBones[i]->mNumWeights ; j++) {
+            uint vertexID = mesh->mBones[i]->mWeights[j].mVertexId;
+            float weight = mesh->mBones[i]->mWeights[j].mWeight;
+            cpuVertexArray[vertexID].AddBoneData(boneIndex, weight);
+        }
+    }
+
+    // Process the index array
+    for (unsigned i = 0; i < mesh->mNumFaces; i++)
+    {
+        aiFace face = mesh->mFaces[i];
+        
+        for (unsigned j = 0; j < face.mNumIndices; j++) {
+            cpuIndexArray.push_back(face.mIndices[j]);
+        }
+    }
+    
+    // Process materials
+    if (scene->HasMaterials())
+    {
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        // Only the diffuse textures are used by the shaders. Their files are loaded by uploadToGPU.
+        for (unsigned i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); i++)
+        {
+            aiString str;
+            material->GetTexture(aiTextureType_DIFFUSE, i, &str);
+            data.diffuseTextures.push_back(str.C_Str());
+        }
+    }
+    
+    return data;
+}
+
+bool SkinnedModelData::cook(const std::string &filename) const
+{
+    if (_released) {
+        std::cout << "Cannot cook " << filename << ", the vertices were released when they were uploaded" << std::endl;
+        return false;
+    }
+    
+    CookedWriter writer(filename);
+    if (!writer.isOpen()) {
+        std::cout << "Cannot write " << filename << std::endl;
+        return false;
+    }
+    
+    writer.writeArray(COOKED_ASSET_MAGIC, (uint32_t)std::strlen(COOKED_ASSET_MAGIC));
+    writer.write((uint32_t)COOKED_ASSET_VERSION);
+    writer.write(_scale);
+    
+    writer.write(_globalInverseTransform);
+    writer.writeArray(_boneOffset);
+    _skeleton.cook(writer);
+    
+    writer.write((uint32_t)_meshData.size());
+    for (const MeshData &data : _meshData) {
+        writer.write((uint32_t)data.vertexFormat.boneIDType);
+        writer.write((uint32_t)data.vertexFormat.weightType);
+        writer.write((uint8_t)data.vertexFormat.octahedralNormals);
+        writer.write((uint8_t)data.vertexFormat.halfTexCoords);
+        writer.writeArray((const unsigned char*)data.vertices, (uint32_t)(data.vertexFormat.getStride() * data.numVertices));
+        writer.writeArray(data.indices, data.numIndices);
+        writer.writeArray(data.drawRanges);
+        writer.write((uint32_t)data.lods.size());
+        for (const MeshData::Lod &level : data.lods) {
+            writer.writeArray(level.indices, level.numIndices);
+            writer.writeArray(level.drawRanges);
+            writer.write(level.error);
+        }
+        writer.writeArray(data.centersOfRotation);
+        writer.write((uint32_t)data.diffuseTextures.size());
+        for (const std::string &texture : data.diffuseTextures) {
+            writer.writeString(texture);
+        }
+    }
+    
+    writer.write((uint32_t)_clips.size());
+    for (const Clip &clip : _clips) {
+        writer.writeString(clip.name);
+        writer.write(clip.ticksPerSecond);
+        writer.write(clip.duration);
+        writer.writeArray(clip.nodes);
+        writer.writeArray(clip.nodeSlots);
+        for (const CompressedChannel &channel : clip.channels) {
+            channel.cook(writer);
+        }
+    }
+    
+    return writer.isOpen();
+}
+
+// True if every one of the numIndices indices points at one of numVertices vertices
+static bool indicesInRange(const int* indices, int numIndices, int numVertices)
+{
+    for (int i = 0; i < numIndices; i++) {
+        if (indices[i] < 0 || indices[i] >= numVertices) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Maps a file written by cook. Vertex and index arrays are left in the mapping until they are uploaded.
+void SkinnedModelData::loadCooked(const std::string &filename, const double scale)
+{
+    _cookedFile.reset(new MappedFile(filename));
+    if (!_cookedFile->isOpen()) {
+        std::cout << "Cannot open " << filename << std::endl;
+        _cookedFile.reset();
+        return;
+    }
+    
+    CookedReader reader(_cookedFile->getData(), _cookedFile->getSize());
+    
+    uint32_t magicSize;
+    const char* magic = reader.readArray<char>(magicSize);
+    const uint32_t version = reader.read<uint32_t>();
+    if (magicSize != std::strlen(COOKED_ASSET_MAGIC) || std::memcmp(magic, COOKED_ASSET_MAGIC, magicSize) != 0 ||
+        version != COOKED_ASSET_VERSION) {
+        std::cout << filename << " was not cooked by this version, cook it again" << std::endl;
+        _cookedFile.reset();
+        return;
+    }
+    
+    _scale = reader.read<double>();
+    if (_scale != scale) {
+        std::cout << filename << " was cooked with scale " << _scale << ", ignoring scale " << scale << std::endl;
+    }
+    
+    _globalInverseTransform = reader.read<Affine3x4>();
+    reader.readArray(_boneOffset);
+    bool damaged = !_skeleton.load(reader, (int)_boneOffset.size());
+    const int numNodes = _skeleton.getNumNodes();
+    
+    // Every mesh, texture name and clip takes at least the 4 bytes of a count in the file
+    _meshData.resize(reader.readCount(sizeof(uint32_t)));
+    for (MeshData &data : _meshData) {
+        uint32_t count;
+        data.vertexFormat.boneIDType = reader.read<uint32_t>();
+        data.vertexFormat.weightType = reader.read<uint32_t>();
+        data.vertexFormat.octahedralNormals = reader.read<uint8_t>() != 0;
+        data.vertexFormat.halfTexCoords = reader.read<uint8_t>() != 0;
+        damaged = damaged || (data.vertexFormat.boneIDType != VERTEX_UNSIGNED_BYTE && data.vertexFormat.boneIDType != VERTEX_UNSIGNED_SHORT &&
+                              data.vertexFormat.boneIDType != VERTEX_UNSIGNED_INT);
+        damaged = damaged || (data.vertexFormat.weightType != VERTEX_UNSIGNED_BYTE && data.vertexFormat.weightType != VERTEX_UNSIGNED_SHORT &&
+                              data.vertexFormat.weightType != VERTEX_FLOAT);
+        data.vertices = reader.readArray<unsigned char>(count);
+        data.numVertices = (int)(count / data.vertexFormat.getStride());
+        damaged = damaged || count % data.vertexFormat.getStride() != 0;
+        data.indices = reader.readArray<int>(count);
+        data.numIndices = (int)count;
+        damaged = damaged || !indicesInRange(data.indices, data.numIndices, data.numVertices);
+        reader.readArray(data.drawRanges);
+        for (const DrawRange &range : data.drawRanges) {
+            damaged = damaged || range.firstIndex < 0 || range.numIndices < 0 || range.firstIndex + range.numIndices > data.numIndices;
+        }
+        const uint32_t numLods = reader.read<uint32_t>();
+        damaged = damaged || numLods >= NUM_LODS;
+        data.lods.resize(damaged ? 0 : numLods);
+        for (MeshData::Lod &level : data.lods) {
+            level.indices = reader.readArray<int>(count);
+            level.numIndices = (int)count;
+            damaged = damaged || !indicesInRange(level.indices, level.numIndices, data.numVertices);
+            reader.readArray(level.drawRanges);
+            level.error = reader.read<float>();
+            for (const DrawRange &range : level.drawRanges) {
+                damaged = damaged || range.firstIndex < 0 || range.numIndices < 0 || range.firstIndex + range.numIndices > level.numIndices;
+            }
+        }
+        reader.readArray(data.centersOfRotation);
+        damaged = damaged || (!data.centersOfRotation.empty() && (int)data.centersOfRotation.size() != data.numVertices);
+        data.diffuseTextures.resize(reader.readCount(sizeof(uint32_t)));
+        for (std::string &texture : data.diffuseTextures) {
+            texture = reader.readString();
+        }
+    }
+    
+    _clips.resize(reader.readCount(sizeof(uint32_t)));
+    for (Clip &clip : _clips) {
+        clip.name = reader.readString();
+        clip.ticksPerSecond = reader.read<float>();
+        clip.duration = reader.read<float>();
+        reader.readArray(clip.nodes);
+        reader.readArray(clip.nodeSlots);
+        
+        // Slots and nodes must point at each other within the skeleton, or posing would index past its arrays
+        const int numSlots = (int)clip.nodes.size();
+        damaged = damaged || (int)clip.nodeSlots.size() != numNodes;
+        for (int slot = 0; slot < numSlots && !damaged; slot++) {
+            damaged = clip.nodes[slot] < 0 || clip.nodes[slot] >= numNodes;
+        }
+        for (int i = 0; i < (int)clip.nodeSlots.size() && !damaged; i++) {
+            damaged = clip.nodeSlots[i] < -1 || clip.nodeSlots[i] >= numSlots;
+        }
+        
+        clip.channels.resize(clip.nodes.size());
+        for (CompressedChannel &channel : clip.channels) {
+            damaged = !channel.load(reader) || damaged;
+        }
+    }
+    
+    if (reader.hasFailed() || damaged) {
+        std::cout << filename << " is truncated or damaged" << std::endl;
+        _meshData.clear();
+        _clips.clear();
+        _boneOffset.clear();
+        _skeleton = Skeleton();
+        _cookedFile.reset();
+        return;
+    }
+    
+    computeLodErrors();
+    _loaded = true;
+    std::cout << "Mapped " << filename << ": " << _meshData.size() << " meshes, " << _boneOffset.size() << " bones, " << _clips.size() << " clips" << std::endl;
+}
+
+const Skeleton& SkinnedModelData::getSkeleton() const
+{
+    return _skeleton;
+}
+
+int SkinnedModelData::getNumBones() const
+{
+    return (int)_boneOffset.size();
+}
+
+const Affine3x4& SkinnedModelData::getBoneOffset(int bone) const
+{
+    return _boneOffset[bone];
+}
+
+const Affine3x4& SkinnedModelData::getGlobalInverseTransform() const
+{
+    return _globalInverseTransform;
+}
+
+int SkinnedModelData::getNumClips() const
+{
+    return (int)_clips.size();
+}
+
+const SkinnedModelData::Clip& SkinnedModelData::getClip(int clip) const
+{
+    return _clips[clip];
+}
+
+const std::vector<MeshOptimizerStats>& SkinnedModelData::getMeshOptimizerStats() const
+{
+    return _optimizerStats;
+}
+
+// A mesh that could not be simplified as far as the others is drawn at its coarsest level
+void SkinnedModelData::computeLodErrors()
+{
+    std::fill(_lodErrors, _lodErrors + NUM_LODS, 0.0f);
+    for (const MeshData &data : _meshData) {
+        for (int lod = 1; lod < NUM_LODS; lod++) {
+            const int level = std::min(lod, (int)data.lods.size()) - 1;
+            if (level >= 0) {
+                _lodErrors[lod] = std::max(_lodErrors[lod], data.lods[level].error);
+            }
+        }
+    }
+}
+
+void SkinnedModelData::releaseMeshData()
+{
+    for (MeshData &data : _meshData) {
+        std::vector<SkinnedVertex>().swap(data.importedVertices);
+        std::vector<unsigned char>().swap(data.packedVertices);
+        std::vector<int>().swap(data.importedIndices);
+        std::vector<glm::vec3>().swap(data.centersOfRotation);
+        data.vertices = nullptr;
+        data.indices = nullptr;
+        for (MeshData::Lod &level : data.lods) {
+            std::vector<int>().swap(level.importedIndices);
+            level.indices = nullptr;
+        }
+    }
+    _cookedFile.reset();
+    _released = true;
+}
@@ -0,0 +1,210 @@
+///
+///  SkinnedModelData.h
+///
+///  Created by Trung Nguyen on 12/12/2018.
+///
+///  \brief The CPU side of a model: skeleton, bone offsets, compressed clips and the processed vertices and indices of
+///         its meshes, imported with Assimp or mapped from a cooked asset. Nothing here needs GL, so models can be
+///         imported, cooked and animated on machines without a GPU. AnimatedModelAsset adds the GPU side.
+///
+
+#ifndef SkinnedModelData_hpp
+#define SkinnedModelData_hpp
+
+#include <atomic>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <assimp/DefaultLogger.hpp>
+#include <assimp/LogStream.hpp>
+#include <assimp/ProgressHandler.hpp>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include "CentersOfRotation.h"
+#include "CompressedClip.h"
+#include "CookedAsset.h"
+#include "MappedFile.h"
+#include "MeshOptimizer.h"
+#include "Skeleton.h"
+#include "SkinnedVertex.h"
+#include "PoseKernel.h"
+
+
+class ProgressReporter : public Assimp::ProgressHandler
+{
+public:
+    explicit ProgressReporter(bool printToConsole = true);
+    ~ProgressReporter();
+    bool Update(float percentage = -1.f);
+    void reset();
+    // Last percentage reported by the importer, can be read from any thread while it imports
+    float getProgress() const;
+private:
+    bool _firstUpdate;
+    bool _printToConsole;
+    std::atomic<float> _progress;
+};
+
+// Choices made when a model is imported. A cooked asset keeps the ones it was cooked with.
+struct ImportSettings {
+    ClipCompressionSettings compression;
+    
+    // Stores the vertices in VertexFormat::packed, with bone IDs just large enough for the model
+    bool packVertices = false;
+    uint32_t packedWeightType = VERTEX_UNSIGNED_BYTE;
+    bool octahedralNormals = true;
+    bool halfTexCoords = true;
+    
+    // Largest total weight dropped from a vertex so that it can be drawn by a skinning variant with fewer influences
+    float influenceTolerance = 0.01f;
+    
+    // Welds identical vertices and reorders triangles and vertices for the vertex caches, see MeshOptimizer
+    bool optimizeMeshes = true;
+    
+    // Simplifies every mesh into NUM_LODS - 1 coarser levels of detail, skinned with fewer influences
+    bool generateLods = true;
+    
+    // Computes the centers of rotation OPTIMIZED_CENTERS_OF_ROTATION needs, or reads them from a cache file next to
+    // the model named after the hash of the mesh
+    bool centersOfRotation = false;
+    float centerOfRotationSigma = CENTERS_OF_ROTATION_SIGMA;
+};
+
+// How a view projects models to the screen, to choose the level of detail they are drawn with
+struct LodView {
+    glm::vec3 eye;
+    float pixelsPerUnit;        // pixels covered by one unit at distance 1, 0 to always draw the full detail
+    float maxErrorPixels;       // a coarser level is drawn once its error covers at most that many pixels
+    
+    LodView();
+    LodView(const glm::vec3 &eye, const glm::mat4 &projection, float viewportHeight, float maxErrorPixels = 1.0f);
+};
+
+class SkinnedModelData
+{
+public:
+    
+    // An aiAnimation compressed and resolved to skeleton nodes once at import. Slot k of the pose streams
+    // samples channels[k] into node nodes[k].
+    struct Clip {
+        std::string name;
+        float ticksPerSecond;
+        float duration;                         // in ticks
+        std::vector<CompressedChannel> channels;
+        std::vector<int> nodes;
+        std::vector<int> nodeSlots;             // slot of every skeleton node, -1 if the node is not animated
+    };
+    
+    /*!
+     * Imports a model file. Scale can be used to scale the vertex locations of the model, settings control how
+     * vertices and animation keys are stored.
+     * Files ending in COOKED_ASSET_EXTENSION are mapped instead of imported; scale and settings were applied when
+     * they were cooked. reporter, if any, receives the progress of the import and must outlive the constructor.
+     */
+    SkinnedModelData(const std::string &filename, const double scale, const ImportSettings &settings = ImportSettings(),
+                     ProgressReporter* reporter = nullptr);
+    // Imports a scene built in memory, which stays owned by the caller. name stands for the file name.
+    SkinnedModelData(const aiScene* importedScene, const std::string &name, const ImportSettings &settings = ImportSettings());
+    
+    virtual ~SkinnedModelData();
+    
+    // False if the file could not be imported or mapped
+    bool isLoaded() const;
+    
+    // Saves everything loaded to a cooked asset. Must be called before the vertices are released to the GPU.
+    bool cook(const std::string &filename) const;
+    
+    // Coarsest level of detail whose simplification error stays within view.maxErrorPixels, for the model at position
+    // scaled by scale
+    int selectLod(const LodView &view, const glm::vec3 &position, float scale = 1.0f) const;
+    // Farthest a vertex of level lod is from the full detail surface, in model units
+    float getLodError(int lod) const;
+    
+    const Skeleton& getSkeleton() const;
+    int getNumBones() const;
+    const Affine3x4& getBoneOffset(int bone) const;
+    const Affine3x4& getGlobalInverseTransform() const;
+    
+    int getNumClips() const;
+    const Clip& getClip(int clip) const;
+    
+    // What the optimizer did to each mesh at import, empty for cooked assets and without ImportSettings::optimizeMeshes
+    const std::vector<MeshOptimizerStats>& getMeshOptimizerStats() const;
+
+protected:
+    
+    // Vertices and materials of a mesh read from the file, kept until they are uploaded. vertices and indices point
+    // either to the imported arrays or into _cookedFile.
+    struct MeshData {
+        std::vector<SkinnedVertex> importedVertices;
+        std::vector<unsigned char> packedVertices;  // replaces importedVertices once packed
+        std::vector<int> importedIndices;
+        VertexFormat vertexFormat;
+        const void* vertices;                       // in vertexFormat
+        int numVertices;
+        const int* indices;
+        int numIndices;
+        std::vector<DrawRange> drawRanges;
+        std::vector<glm::vec3> centersOfRotation;   // one per vertex, or empty
+        std::vector<std::string> diffuseTextures;
+        
+        // Triangles of a coarser level of detail, in the same vertices
+        struct Lod {
+            std::vector<int> importedIndices;
+            const int* indices;
+            int numIndices;
+            std::vector<DrawRange> drawRanges;
+            float error;
+        };
+        std::vector<Lod> lods;                      // from level 1
+    };
+    
+    std::vector<MeshData> _meshData;
+    
+    // Frees the vertices and indices of every mesh and the cooked file they may point into, once the GPU holds them
+    void releaseMeshData();
+
+private:
+    
+    SkinnedModelData(const SkinnedModelData&) = delete;
+    SkinnedModelData& operator=(const SkinnedModelData&) = delete;
+    
+    double _scale;
+    
+    const aiScene* scene;
+    
+    std::unique_ptr<Assimp::Importer> _importer;
+    
+    std::unique_ptr<MappedFile> _cookedFile;
+    bool _loaded;
+    bool _released;
+    float _lodErrors[NUM_LODS];                 // largest error of a mesh at every level
+    
+    std::map<std::string, int> _boneMapping = {};
+    std::vector<Affine3x4> _boneOffset;         // one per bone
+    
+    Affine3x4 _globalInverseTransform;
+    
+    Skeleton _skeleton;
+    std::vector<Clip> _clips;                   // one per scene->mAnimations
+    ImportSettings _settings;
+    std::vector<MeshOptimizerStats> _optimizerStats;
+    
+    void importMesh(const std::string &filename, int &numIndices, const double scale, ProgressReporter* reporter);
+    void importScene(const aiScene* importedScene, const std::string &filename, const double scale);
+    void loadCooked(const std::string &filename, const double scale);
+    void processNode(aiNode* node, const aiScene* scene, const glm::mat4 scaleMat);
+    void bindAnimations();
+    void generateLods(MeshData &data) const;
+    void computeLodErrors();
+    
+    MeshData processMesh(aiMesh* mesh, const aiScene* scene, const glm::mat4 scaleMat);
+};
+
+#endif /* SkinnedModelData_hpp */
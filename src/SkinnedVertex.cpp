@@ -0,0 +1,283 @@
+//
+//  SkinnedVertex.cpp
+//
+
+#include "SkinnedVertex.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+int getInfluenceVariant(int numInfluences)
+{
+    int variant = 0;
+    while (variant < NUM_INFLUENCE_VARIANTS - 1 && getVariantInfluences(variant) < numInfluences) {
+        variant++;
+    }
+    return variant;
+}
+
+int getVariantInfluences(int variant)
+{
+    return 1 << variant;
+}
+
+// Bytes per component of type
+static int componentSize(uint32_t type)
+{
+    switch (type) {
+        case VERTEX_UNSIGNED_BYTE:
+            return 1;
+        case VERTEX_UNSIGNED_SHORT:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+VertexFormat::VertexFormat() : boneIDType(VERTEX_UNSIGNED_INT), weightType(VERTEX_FLOAT), octahedralNormals(false), halfTexCoords(false)
+{
+}
+
+bool VertexFormat::operator==(const VertexFormat &other) const
+{
+    return boneIDType == other.boneIDType && weightType == other.weightType && octahedralNormals == other.octahedralNormals
+        && halfTexCoords == other.halfTexCoords;
+}
+
+VertexFormat VertexFormat::packed(int numBones, uint32_t weightType, bool octahedralNormals, bool halfTexCoords)
+{
+    VertexFormat format;
+    format.boneIDType = numBones <= 256 ? VERTEX_UNSIGNED_BYTE : (numBones <= 65536 ? VERTEX_UNSIGNED_SHORT : VERTEX_UNSIGNED_INT);
+    format.weightType = weightType;
+    format.octahedralNormals = octahedralNormals;
+    format.halfTexCoords = halfTexCoords;
+    return format;
+}
+
+bool VertexFormat::isFull() const
+{
+    return boneIDType == VERTEX_UNSIGNED_INT && weightType == VERTEX_FLOAT && !octahedralNormals && !halfTexCoords;
+}
+
+int VertexFormat::getNormalOffset() const
+{
+    return sizeof(glm::vec3);
+}
+
+int VertexFormat::getTexCoordOffset() const
+{
+    return getNormalOffset() + (octahedralNormals ? 2 * sizeof(int16_t) : sizeof(glm::vec3));
+}
+
+int VertexFormat::getBoneIDOffset() const
+{
+    return getTexCoordOffset() + (halfTexCoords ? 2 * sizeof(uint16_t) : sizeof(glm::vec2));
+}
+
+int VertexFormat::getWeightOffset() const
+{
+    return getBoneIDOffset() + NUM_BONES_PER_VERTEX * componentSize(boneIDType);
+}
+
+int VertexFormat::getStride() const
+{
+    // Keep every vertex 4 byte aligned
+    const int size = getWeightOffset() + NUM_BONES_PER_VERTEX * componentSize(weightType);
+    return (size + 3) & ~3;
+}
+
+// Maps a unit vector onto the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper one
+static glm::vec2 octahedralEncode(const glm::vec3 &normal)
+{
+    const glm::vec3 n = normal / (std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z));
+    if (n.z >= 0.0f) {
+        return glm::vec2(n.x, n.y);
+    }
+    return glm::vec2((1.0f - std::fabs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::fabs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// IEEE half float, rounded to nearest
+static uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    
+    const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+    
+    if (exponent >= 31) {
+        // Too large, infinity or NaN
+        const bool isNaN = ((bits >> 23) & 0xff) == 0xff && mantissa != 0;
+        return sign | 0x7c00 | (isNaN ? 0x200 : 0);
+    }
+    if (exponent <= 0) {
+        // Denormal or zero
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        half += (mantissa >> (shift - 1)) & 1;
+        return sign | (uint16_t)half;
+    }
+    
+    // A carry out of the mantissa correctly rounds up into the exponent
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1;
+    return sign | (uint16_t)half;
+}
+
+template <typename T>
+static void writeValue(unsigned char* &out, T value)
+{
+    std::memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+}
+
+void VertexFormat::pack(const SkinnedVertex* vertices, int numVertices, std::vector<unsigned char> &packed) const
+{
+    const int stride = getStride();
+    packed.assign((size_t)stride * numVertices, 0);
+    if (isFull()) {
+        std::memcpy(packed.data(), vertices, packed.size());
+        return;
+    }
+    
+    for (int v = 0; v < numVertices; v++) {
+        const SkinnedVertex &vertex = vertices[v];
+        unsigned char* out = &packed[(size_t)v * stride];
+        
+        writeValue(out, vertex.position);
+        
+        if (octahedralNormals) {
+            const glm::vec2 encoded = octahedralEncode(vertex.normal);
+            writeValue(out, (int16_t)std::round(glm::clamp(encoded.x, -1.0f, 1.0f) * 32767.0f));
+            writeValue(out, (int16_t)std::round(glm::clamp(encoded.y, -1.0f, 1.0f) * 32767.0f));
+        }
+        else {
+            writeValue(out, vertex.normal);
+        }
+        
+        if (halfTexCoords) {
+            writeValue(out, floatToHalf(vertex.texCoord0.x));
+            writeValue(out, floatToHalf(vertex.texCoord0.y));
+        }
+        else {
+            writeValue(out, vertex.texCoord0);
+        }
+        
+        for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+            if (boneIDType == VERTEX_UNSIGNED_BYTE) {
+                assert(vertex.IDs[i] < 256);
+                writeValue(out, (uint8_t)vertex.IDs[i]);
+            }
+            else if (boneIDType == VERTEX_UNSIGNED_SHORT) {
+                assert(vertex.IDs[i] < 65536);
+                writeValue(out, (uint16_t)vertex.IDs[i]);
+            }
+            else {
+                writeValue(out, (uint32_t)vertex.IDs[i]);
+            }
+        }
+        
+        if (weightType == VERTEX_FLOAT) {
+            for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+                writeValue(out, vertex.weights[i]);
+            }
+            continue;
+        }
+        
+        // Round every weight, then give what rounding lost or added to the largest one so that they still sum to one
+        const int maxValue = weightType == VERTEX_UNSIGNED_BYTE ? 255 : 65535;
+        int quantized[NUM_BONES_PER_VERTEX];
+        int sum = 0;
+        int largest = 0;
+        float total = 0.0f;
+        for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+            quantized[i] = (int)std::round(glm::clamp(vertex.weights[i], 0.0f, 1.0f) * maxValue);
+            sum += quantized[i];
+            total += vertex.weights[i];
+            if (vertex.weights[i] > vertex.weights[largest]) {
+                largest = i;
+            }
+        }
+        if (std::fabs(total - 1.0f) < 0.01f) {
+            quantized[largest] = glm::clamp(quantized[largest] + maxValue - sum, 0, maxValue);
+        }
+        
+        for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+            if (weightType == VERTEX_UNSIGNED_BYTE) {
+                writeValue(out, (uint8_t)quantized[i]);
+            }
+            else {
+                writeValue(out, (uint16_t)quantized[i]);
+            }
+        }
+    }
+}
+
+//Adds bone data to a vertex. Looks for the next open slot on the VBO, and puts the boneID and weight in that slot. When
+//every slot is taken the smallest weight makes room if Weight is larger; PruneBoneData renormalizes what is left.
+void SkinnedVertex::AddBoneData(int BoneID, float Weight) {
+    int smallest = 0;
+    for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+        if (weights[i] == 0) {
+            IDs[i] = BoneID;
+            weights[i] = Weight;
+
+//            std::cout << std::endl << "Position: " << glm::to_string(position) << std::endl << "ID: ";
+//            for (uint id: IDs) { std::cout << id << "\t"; };
+//            std::cout << std::endl << "Weights: ";
+//            float sum = 0;
+//            for (float weight: weights) { std::cout << weight << "\t"; sum += weight; };
+//            std::cout << std::endl << sum << std::endl;
+
+            return;
+        }
+        if (weights[i] < weights[smallest]) {
+            smallest = i;
+        }
+    }
+    
+    // more bones than we have space for
+    if (Weight > weights[smallest]) {
+        IDs[smallest] = BoneID;
+        weights[smallest] = Weight;
+    }
+}
+
+int SkinnedVertex::PruneBoneData(float tolerance) {
+    int order[NUM_BONES_PER_VERTEX];
+    for (int i = 0; i < NUM_BONES_PER_VERTEX; i++) {
+        order[i] = i;
+    }
+    std::sort(order, order + NUM_BONES_PER_VERTEX, [this](int a, int b) { return weights[a] > weights[b]; });
+    
+    // Always keep the largest influence
+    int count = NUM_BONES_PER_VERTEX;
+    float dropped = 0.0f;
+    while (count > 1 && dropped + weights[order[count - 1]] <= tolerance) {
+        dropped += weights[order[count - 1]];
+        count--;
+    }
+    
+    float total = 0.0f;
+    for (int i = 0; i < count; i++) {
+        total += weights[order[i]];
+    }
+    
+    uint32_t sortedIDs[NUM_BONES_PER_VERTEX] = {};
+    float sortedWeights[NUM_BONES_PER_VERTEX] = {};
+    for (int i = 0; i < count; i++) {
+        sortedIDs[i] = IDs[order[i]];
+        sortedWeights[i] = total > 0.0f ? weights[order[i]] / total : 0.0f;
+    }
+    std::memcpy(IDs, sortedIDs, sizeof(IDs));
+    std::memcpy(weights, sortedWeights, sizeof(weights));
+    
+    return count;
+}
@@ -0,0 +1,90 @@
+///
+///  SkinnedVertex.h
+///
+///  \brief Vertices of skinned meshes as they are imported and processed on the CPU, and the layouts they are packed
+///         to for the GPU. Nothing here needs GL: the component types of a layout have the values of the GL enums
+///         they stand for, so that BoneMesh hands them to GL as they are.
+///
+
+#ifndef SkinnedVertex_hpp
+#define SkinnedVertex_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+#define NUM_BONES_PER_VERTEX 8
+
+// Skinning shaders are compiled for 1, 2, 4 and 8 influences per vertex
+#define NUM_INFLUENCE_VARIANTS 4
+
+// Index of the smallest variant reading at least numInfluences influences
+int getInfluenceVariant(int numInfluences);
+int getVariantInfluences(int variant);
+
+// Component types of a VertexFormat, equal to GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT and GL_FLOAT
+enum VertexComponentType {
+    VERTEX_UNSIGNED_BYTE = 0x1401,
+    VERTEX_UNSIGNED_SHORT = 0x1403,
+    VERTEX_UNSIGNED_INT = 0x1405,
+    VERTEX_FLOAT = 0x1406
+};
+
+struct SkinnedVertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoord0;
+    uint32_t IDs[NUM_BONES_PER_VERTEX];
+    float weights[NUM_BONES_PER_VERTEX];
+    
+    SkinnedVertex() {
+        position = glm::vec3(0.0);
+        normal = glm::vec3(0.0);
+        texCoord0 = glm::vec2(0.0);
+        std::memset(IDs, 0, sizeof(uint32_t) * NUM_BONES_PER_VERTEX);
+        std::memset(weights, 0, sizeof(float) * NUM_BONES_PER_VERTEX);
+    };
+    
+    void AddBoneData(int BoneID, float Weight);
+    
+    // Drops the smallest weights as long as they add up to at most tolerance, renormalizes the others and moves
+    // them to the first slots, largest first. Returns the number of influences left.
+    int PruneBoneData(float tolerance);
+};
+
+// Indices drawn by one variant of SkinningShaders: no vertex of their primitives has more than numInfluences weights
+struct DrawRange {
+    int numInfluences;
+    int firstIndex;
+    int numIndices;
+};
+
+// Layout of the vertices in the VBO. The default is SkinnedVertex as it is; packed() stores bone IDs and weights in
+// 8 or 16 bits and can squeeze normals and texture coordinates, which vertex.glsl reads through the same inputs.
+struct VertexFormat {
+    uint32_t boneIDType;        // VERTEX_UNSIGNED_BYTE, VERTEX_UNSIGNED_SHORT or VERTEX_UNSIGNED_INT
+    uint32_t weightType;        // VERTEX_UNSIGNED_BYTE or VERTEX_UNSIGNED_SHORT read as unorm, or VERTEX_FLOAT
+    bool octahedralNormals;     // two snorm16 instead of three floats
+    bool halfTexCoords;         // two half floats instead of two floats
+    
+    VertexFormat();
+    
+    // Smallest bone IDs that can address numBones bones
+    static VertexFormat packed(int numBones, uint32_t weightType = VERTEX_UNSIGNED_BYTE, bool octahedralNormals = true, bool halfTexCoords = true);
+    
+    bool operator==(const VertexFormat &other) const;
+    bool isFull() const;
+    int getStride() const;
+    int getNormalOffset() const;
+    int getTexCoordOffset() const;
+    int getBoneIDOffset() const;
+    int getWeightOffset() const;
+    
+    // Converts vertices to this layout, getStride() bytes per vertex
+    void pack(const SkinnedVertex* vertices, int numVertices, std::vector<unsigned char> &packed) const;
+};
+
+#endif /* SkinnedVertex_hpp */
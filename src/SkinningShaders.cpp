@@ -0,0 +1,151 @@
+//
+//  SkinningShaders.cpp
+//
+
+#include "SkinningShaders.h"
+#include "PaletteBuffer.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <glm/gtc/type_ptr.hpp>
+
+
+std::atomic<unsigned int> SkinningShaders::_invalidations(0);
+
+int SkinningShaders::getVariantIndex(int numInfluences)
+{
+    return getInfluenceVariant(numInfluences);
+}
+
+int SkinningShaders::getVariantInfluences(int variant)
+{
+    return ::getVariantInfluences(variant);
+}
+
+void SkinningShaders::compile(const std::string &vertexFile, const std::string &fragmentFile)
+{
+    std::ifstream file(vertexFile.c_str());
+    if (!file) {
+        std::cout << "Cannot open " << vertexFile << std::endl;
+        return;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    const std::string source = contents.str();
+    
+    // #version has to stay the first line
+    const size_t versionEnd = source.find('\n', source.find("#version")) + 1;
+    
+    for (int m = 0; m < NUM_SKINNING_MODES; m++) {
+        for (int v = 0; v < NUM_VARIANTS; v++) {
+            std::stringstream variantSource;
+            variantSource << source.substr(0, versionEnd) << "#define NUM_INFLUENCES " << getVariantInfluences(v) << "\n";
+            if (m == DUAL_QUATERNION_SKINNING) {
+                variantSource << "#define DUAL_QUATERNION_SKINNING\n";
+            }
+            else if (m == OPTIMIZED_CENTERS_OF_ROTATION) {
+                variantSource << "#define OPTIMIZED_CENTERS_OF_ROTATION\n";
+            }
+            variantSource << source.substr(versionEnd);
+            
+            _programs[m][v].compileShader(variantSource.str(), basicgraphics::GLSLShader::VERTEX, vertexFile.c_str());
+            _programs[m][v].compileShader(fragmentFile.c_str(), basicgraphics::GLSLShader::FRAGMENT);
+            _programs[m][v].link();
+            
+            _programs[m][v].use();
+            _programs[m][v].setUniform("palette", PaletteBuffer::TEXTURE_UNIT);
+            
+            const GLuint handle = _programs[m][v].getHandle();
+            Locations &locations = _locations[m][v];
+            locations.view = glGetUniformLocation(handle, "view_mat");
+            locations.projection = glGetUniformLocation(handle, "projection_mat");
+            locations.eyeWorld = glGetUniformLocation(handle, "eye_world");
+            locations.paletteOffset = glGetUniformLocation(handle, "paletteOffset");
+            locations.instancesOffset = glGetUniformLocation(handle, "instancesOffset");
+            locations.instanceListOffset = glGetUniformLocation(handle, "instanceListOffset");
+        }
+    }
+    resetProgramValues();
+}
+
+void SkinningShaders::resetProgramValues()
+{
+    for (int m = 0; m < NUM_SKINNING_MODES; m++) {
+        for (int v = 0; v < NUM_VARIANTS; v++) {
+            // Values no draw uses, so that the first draw sets them all. The camera is set from the first setView.
+            ProgramValues &values = _programValues[m][v];
+            values.viewVersion = 0;
+            values.paletteOffset = -1;
+            values.instancesOffset = -1;
+            values.instanceListOffset = -2;
+        }
+    }
+    _invalidation = _invalidations;
+}
+
+basicgraphics::GLSLProgram& SkinningShaders::getVariant(int numInfluences, SkinningMode mode)
+{
+    return _programs[mode][getVariantIndex(numInfluences)];
+}
+
+void SkinningShaders::setView(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &eyeWorld)
+{
+    _view = view;
+    _projection = projection;
+    _eyeWorld = eyeWorld;
+    _viewVersion++;
+}
+
+void SkinningShaders::setPaletteOffset(GLint offset)
+{
+    _paletteOffset = offset;
+}
+
+void SkinningShaders::setInstancesOffset(GLint offset, GLint listOffset)
+{
+    _instancesOffset = offset;
+    _instanceListOffset = listOffset;
+}
+
+basicgraphics::GLSLProgram& SkinningShaders::use(int numInfluences, SkinningMode mode)
+{
+    basicgraphics::GLSLProgram &program = getVariant(numInfluences, mode);
+    program.use();
+    applyUniforms(numInfluences, mode);
+    return program;
+}
+
+void SkinningShaders::applyUniforms(int numInfluences, SkinningMode mode)
+{
+    if (_invalidation != _invalidations) {
+        resetProgramValues();
+    }
+    
+    const int variant = getVariantIndex(numInfluences);
+    const Locations &locations = _locations[mode][variant];
+    ProgramValues &values = _programValues[mode][variant];
+    if (values.viewVersion != _viewVersion) {
+        glUniformMatrix4fv(locations.view, 1, GL_FALSE, glm::value_ptr(_view));
+        glUniformMatrix4fv(locations.projection, 1, GL_FALSE, glm::value_ptr(_projection));
+        glUniform3fv(locations.eyeWorld, 1, glm::value_ptr(_eyeWorld));
+        values.viewVersion = _viewVersion;
+    }
+    if (values.paletteOffset != _paletteOffset) {
+        glUniform1i(locations.paletteOffset, _paletteOffset);
+        values.paletteOffset = _paletteOffset;
+    }
+    if (values.instancesOffset != _instancesOffset) {
+        glUniform1i(locations.instancesOffset, _instancesOffset);
+        values.instancesOffset = _instancesOffset;
+    }
+    if (values.instanceListOffset != _instanceListOffset) {
+        glUniform1i(locations.instanceListOffset, _instanceListOffset);
+        values.instanceListOffset = _instanceListOffset;
+    }
+}
+
+void SkinningShaders::invalidateUniforms()
+{
+    _invalidations++;
+}
@@ -0,0 +1,112 @@
+///
+///  SkinningShaders.h
+///
+///  \brief Variants of a skinning program, each compiled for a fixed number of bone influences per vertex. Meshes
+///         draw each range of their triangles with the smallest variant that covers its vertices, so most vertices
+///         skip the weights they do not have. Every variant exists for linear blend and for dual quaternion skinning.
+///
+
+#ifndef SkinningShaders_hpp
+#define SkinningShaders_hpp
+
+#include <atomic>
+#include <string>
+#include <glm/glm.hpp>
+#include "GLSLProgram.h"
+#include "SkinnedVertex.h"
+
+
+enum SkinningMode {
+    LINEAR_BLEND_SKINNING,      // a matrix per bone from the palette buffer
+    DUAL_QUATERNION_SKINNING,   // real and dual parts of each bone from the palette buffer, half the size
+    OPTIMIZED_CENTERS_OF_ROTATION,  // both, and a center of rotation per vertex
+    NUM_SKINNING_MODES
+};
+
+class SkinningShaders
+{
+public:
+    
+    // Variants read 1, 2, 4 and 8 influences
+    static const int NUM_VARIANTS = NUM_INFLUENCE_VARIANTS;
+    
+    // Index of the smallest variant reading at least numInfluences influences
+    static int getVariantIndex(int numInfluences);
+    static int getVariantInfluences(int variant);
+    
+    // Compiles the vertex shader once per variant with NUM_INFLUENCES, and DUAL_QUATERNION_SKINNING or
+    // OPTIMIZED_CENTERS_OF_ROTATION for those modes, defined after its #version line. Every variant reads the
+    // palette from PaletteBuffer::TEXTURE_UNIT.
+    void compile(const std::string &vertexFile, const std::string &fragmentFile);
+    
+    basicgraphics::GLSLProgram& getVariant(int numInfluences, SkinningMode mode = LINEAR_BLEND_SKINNING);
+    
+    // Camera of the following draws, set once per eye
+    void setView(const glm::mat4 &view, const glm::mat4 &projection, const glm::vec3 &eyeWorld);
+    // Texel where the following draws find the palette frame in the bound buffer
+    void setPaletteOffset(GLint offset);
+    // Texel of the palette frame where the following draws find the record of their first instance, or with a
+    // listOffset, the offsets of the records of their instances
+    void setInstancesOffset(GLint offset, GLint listOffset = -1);
+    
+    // Makes a variant current, with the uniforms above set if they changed since the variant last drew
+    basicgraphics::GLSLProgram& use(int numInfluences, SkinningMode mode = LINEAR_BLEND_SKINNING);
+    // Same for a variant that is already current
+    void applyUniforms(int numInfluences, SkinningMode mode = LINEAR_BLEND_SKINNING);
+    
+    // Forgets the values every variant of every SkinningShaders has, so that their next draws set them all again.
+    // Call after setting palette or instance uniforms on a variant directly.
+    static void invalidateUniforms();
+    
+    // Sets a uniform shared by every variant. Uniforms with a setter above go through it instead.
+    template <typename T>
+    void setUniform(const std::string &name, const T &value)
+    {
+        for (int m = 0; m < NUM_SKINNING_MODES; m++) {
+            for (int v = 0; v < NUM_VARIANTS; v++) {
+                _programs[m][v].use();
+                _programs[m][v].setUniform(name.c_str(), value);
+            }
+        }
+    }
+
+private:
+    
+    basicgraphics::GLSLProgram _programs[NUM_SKINNING_MODES][NUM_VARIANTS];
+    
+    void resetProgramValues();
+    
+    struct Locations {
+        GLint view;
+        GLint projection;
+        GLint eyeWorld;
+        GLint paletteOffset;
+        GLint instancesOffset;
+        GLint instanceListOffset;
+    };
+    
+    // Values a program has. The camera is compared by the number of setView calls it was set at.
+    struct ProgramValues {
+        unsigned int viewVersion;
+        GLint paletteOffset;
+        GLint instancesOffset;
+        GLint instanceListOffset;
+    };
+    
+    // Locations looked up at compile, and the values each program has
+    Locations _locations[NUM_SKINNING_MODES][NUM_VARIANTS];
+    ProgramValues _programValues[NUM_SKINNING_MODES][NUM_VARIANTS];
+    unsigned int _invalidation = 0;
+    
+    glm::mat4 _view;
+    glm::mat4 _projection;
+    glm::vec3 _eyeWorld;
+    unsigned int _viewVersion = 0;
+    GLint _paletteOffset = 0;
+    GLint _instancesOffset = 0;
+    GLint _instanceListOffset = -1;
+    
+    static std::atomic<unsigned int> _invalidations;
+};
+
+#endif /* SkinningShaders_hpp */
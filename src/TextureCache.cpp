@@ -0,0 +1,244 @@
+//
+//  TextureCache.cpp
+//
+
+#include "TextureCache.h"
+#include "GLContext.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+
+// BasicGraphics decodes its textures with stb_image and ships the header
+#include "stb_image.h"
+
+
+// Same path for every way of naming a file, as given if it does not exist
+static std::string resolvePath(const std::string &path)
+{
+#ifdef _WIN32
+    char resolved[_MAX_PATH];
+    if (_fullpath(resolved, path.c_str(), _MAX_PATH) != nullptr) {
+        return resolved;
+    }
+#else
+    char resolved[PATH_MAX];
+    if (realpath(path.c_str(), resolved) != nullptr) {
+        return resolved;
+    }
+#endif
+    return path;
+}
+
+// FNV-1a of the file, as the centers of rotation are cached
+static uint64_t hashContents(const char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+TextureCache& TextureCache::get()
+{
+    static TextureCache cache;
+    return cache;
+}
+
+TextureCache::TextureCache() : _numReused(0)
+{
+}
+
+std::shared_ptr<TextureCache::Image> TextureCache::decode(const std::string &path)
+{
+    return decode(path, true);
+}
+
+std::shared_ptr<TextureCache::Image> TextureCache::decode(const std::string &path, bool skipAlive)
+{
+    std::shared_ptr<Image> image = std::make_shared<Image>();
+    image->path = resolvePath(path);
+    if (skipAlive) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (isAlive(image->path, nullptr)) {
+            return image;
+        }
+    }
+    
+    MappedFile file(image->path);
+    if (!file.isOpen()) {
+        std::cout << "Could not read texture " << path << std::endl;
+        image->failed = true;
+        return image;
+    }
+    image->contentHash = hashContents(file.getData(), file.getSize());
+    if (skipAlive) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (isAlive(image->path, &image->contentHash)) {
+            return image;
+        }
+    }
+    
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    unsigned char* pixels = stbi_load_from_memory((const unsigned char*)file.getData(), (int)file.getSize(), &width, &height, &channels, 4);
+    if (pixels == nullptr) {
+        std::cout << "Could not decode texture " << path << ": " << stbi_failure_reason() << std::endl;
+        image->failed = true;
+        return image;
+    }
+    
+    // Opaque images drop their alpha, which also keeps their meshes out of the translucent pass
+    bool opaque = true;
+    const size_t numPixels = (size_t)width * height;
+    for (size_t i = 0; i < numPixels && opaque; i++) {
+        opaque = pixels[4 * i + 3] == 255;
+    }
+    image->width = width;
+    image->height = height;
+    image->channels = opaque ? 3 : 4;
+    image->pixels.resize(numPixels * image->channels);
+    if (opaque) {
+        for (size_t i = 0; i < numPixels; i++) {
+            image->pixels[3 * i + 0] = pixels[4 * i + 0];
+            image->pixels[3 * i + 1] = pixels[4 * i + 1];
+            image->pixels[3 * i + 2] = pixels[4 * i + 2];
+        }
+    }
+    else {
+        std::copy(pixels, pixels + image->pixels.size(), image->pixels.begin());
+    }
+    stbi_image_free(pixels);
+    
+    return image;
+}
+
+std::vector< std::shared_ptr<TextureCache::Image> > TextureCache::decode(const std::vector<std::string> &paths, JobSystem* jobs)
+{
+    std::vector< std::shared_ptr<Image> > images(paths.size());
+    auto job = [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            images[i] = decode(paths[i]);
+        }
+    };
+    if (jobs != nullptr) {
+        jobs->parallelFor((int)paths.size(), 1, job);
+    }
+    else {
+        job(0, (int)paths.size());
+    }
+    return images;
+}
+
+std::shared_ptr<basicgraphics::Texture> TextureCache::upload(const Image &image)
+{
+    if (image.failed) {
+        return nullptr;
+    }
+    const void* context = currentGLContext();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ContextTextures &textures = _contexts[context];
+        std::shared_ptr<basicgraphics::Texture> texture = find(textures, image.path, image.contentHash != 0 ? &image.contentHash : nullptr);
+        if (texture) {
+            textures.byPath[image.path] = texture;
+            _numReused++;
+            return texture;
+        }
+    }
+    
+    // The texture it was decoded to skip has been freed since, or lives in another context
+    if (image.pixels.empty()) {
+        return upload(*decode(image.path, false));
+    }
+    
+    // Rows of RGB images are not padded to 4 bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    const GLenum format = image.channels == 4 ? GL_RGBA : GL_RGB;
+    std::shared_ptr<basicgraphics::Texture> texture = basicgraphics::Texture::createFromMemory(image.width, image.height, format,
+        image.channels == 4 ? GL_RGBA8 : GL_RGB8, GL_TEXTURE_2D, GL_UNSIGNED_BYTE, &image.pixels[0], GL_REPEAT, GL_LINEAR);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    
+    std::lock_guard<std::mutex> lock(_mutex);
+    removeExpired();
+    _contexts[context].byPath[image.path] = texture;
+    _contexts[context].byContent[image.contentHash] = texture;
+    return texture;
+}
+
+std::shared_ptr<basicgraphics::Texture> TextureCache::load(const std::string &path)
+{
+    return upload(*decode(path));
+}
+
+int TextureCache::getNumTextures() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    int numTextures = 0;
+    for (const auto &context : _contexts) {
+        for (const auto &entry : context.second.byContent) {
+            numTextures += entry.second.expired() ? 0 : 1;
+        }
+    }
+    return numTextures;
+}
+
+int TextureCache::getNumReused() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _numReused;
+}
+
+bool TextureCache::isAlive(const std::string &path, const uint64_t* contentHash) const
+{
+    for (const std::pair<const void* const, ContextTextures> &context : _contexts) {
+        const ContextTextures &textures = context.second;
+        std::map<std::string, std::weak_ptr<basicgraphics::Texture> >::const_iterator byPath = textures.byPath.find(path);
+        if (byPath != textures.byPath.end() && !byPath->second.expired()) {
+            return true;
+        }
+        if (contentHash != nullptr) {
+            std::map<uint64_t, std::weak_ptr<basicgraphics::Texture> >::const_iterator byContent = textures.byContent.find(*contentHash);
+            if (byContent != textures.byContent.end() && !byContent->second.expired()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::shared_ptr<basicgraphics::Texture> TextureCache::find(const ContextTextures &textures, const std::string &path, const uint64_t* contentHash)
+{
+    std::map<std::string, std::weak_ptr<basicgraphics::Texture> >::const_iterator byPath = textures.byPath.find(path);
+    if (byPath != textures.byPath.end()) {
+        std::shared_ptr<basicgraphics::Texture> texture = byPath->second.lock();
+        if (texture) {
+            return texture;
+        }
+    }
+    if (contentHash != nullptr) {
+        std::map<uint64_t, std::weak_ptr<basicgraphics::Texture> >::const_iterator byContent = textures.byContent.find(*contentHash);
+        if (byContent != textures.byContent.end()) {
+            return byContent->second.lock();
+        }
+    }
+    return nullptr;
+}
+
+void TextureCache::removeExpired()
+{
+    for (auto &context : _contexts) {
+        ContextTextures &textures = context.second;
+        for (auto it = textures.byPath.begin(); it != textures.byPath.end(); ) {
+            it = it->second.expired() ? textures.byPath.erase(it) : std::next(it);
+        }
+        for (auto it = textures.byContent.begin(); it != textures.byContent.end(); ) {
+            it = it->second.expired() ? textures.byContent.erase(it) : std::next(it);
+        }
+    }
+}
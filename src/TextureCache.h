@@ -0,0 +1,85 @@
+///
+///  TextureCache.h
+///
+///  \brief Process-wide cache of the textures of every model, so that an image used by several models is decoded
+///         and uploaded once. Textures are found by the resolved path of their file, or by the hash of its contents
+///         when the same image is saved under another name. The cache only holds weak references: a texture is freed
+///         with the last mesh using it. Files are read and decoded on any thread, and only the upload needs the GL
+///         context. Textures are cached per context, a file drawn by several contexts is decoded once and uploaded to
+///         each.
+///
+
+#ifndef TextureCache_hpp
+#define TextureCache_hpp
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+#include "Texture.h"
+
+
+class TextureCache
+{
+public:
+    
+    // An image file decoded for upload. pixels stays empty if a texture of the same file was alive in any context
+    // when it was decoded, or if the file could not be read.
+    struct Image {
+        std::string path;                   // resolved
+        uint64_t contentHash = 0;
+        int width = 0;
+        int height = 0;
+        int channels = 0;                   // 3 when every pixel is opaque, 4 otherwise
+        std::vector<unsigned char> pixels;
+        bool failed = false;
+    };
+    
+    static TextureCache& get();
+    
+    // Reads and decodes path, unless a texture of it is alive. Can be called from any thread.
+    std::shared_ptr<Image> decode(const std::string &path);
+    
+    // Decodes paths in parallel on jobs, or on the calling thread without jobs
+    std::vector< std::shared_ptr<Image> > decode(const std::vector<std::string> &paths, JobSystem* jobs);
+    
+    // Returns the texture of image, uploading it unless a texture of the same file or contents is alive in the current
+    // GL context. Returns null if the file could not be read.
+    std::shared_ptr<basicgraphics::Texture> upload(const Image &image);
+    
+    // Same as decode and upload on the context thread
+    std::shared_ptr<basicgraphics::Texture> load(const std::string &path);
+    
+    // Textures alive in every context, and uploads skipped because one of the same file or contents was
+    int getNumTextures() const;
+    int getNumReused() const;
+
+private:
+    
+    TextureCache();
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+    
+    struct ContextTextures {
+        std::map<std::string, std::weak_ptr<basicgraphics::Texture> > byPath;
+        std::map<uint64_t, std::weak_ptr<basicgraphics::Texture> > byContent;
+    };
+    
+    mutable std::mutex _mutex;
+    std::map<const void*, ContextTextures> _contexts;  // by currentGLContext()
+    int _numReused;
+    
+    // Same as decode, also decoding files whose textures are alive when skipAlive is false
+    std::shared_ptr<Image> decode(const std::string &path, bool skipAlive);
+    
+    // Must hold _mutex. Only the context thread takes references, any other thread could end up freeing a texture.
+    // isAlive looks in every context, find in textures.
+    bool isAlive(const std::string &path, const uint64_t* contentHash) const;
+    static std::shared_ptr<basicgraphics::Texture> find(const ContextTextures &textures, const std::string &path, const uint64_t* contentHash);
+    void removeExpired();
+};
+
+#endif /* TextureCache_hpp */
@@ -0,0 +1,41 @@
+//
+//  AssetCooker.cpp
+//
+//  Imports a model with Assimp and saves it as a cooked asset, which AnimatedModelAsset maps instead of importing
+//  the original file. Cook again after changing the model, the scale or the import settings. Vertices are stored in
+//  the packed format unless "full" is given, along with their centers of rotation.
+//
+//  Usage: asset-cooker <model file> [scale, defaults to 1] [output file, defaults to the model file + .cooked] [packed|full]
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+#include "SkinnedModelData.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::printf("Usage: %s <model file> [scale] [output file] [packed|full]\n", argv[0]);
+        return 1;
+    }
+    
+    const std::string filename = argv[1];
+    const double scale = argc > 2 ? std::atof(argv[2]) : 1.0;
+    const std::string output = argc > 3 ? argv[3] : filename + COOKED_ASSET_EXTENSION;
+    
+    ImportSettings settings;
+    settings.packVertices = argc <= 4 || std::string(argv[4]) != "full";
+    settings.centersOfRotation = true;
+    
+    // Only the CPU side is loaded, so no GL context is created
+    std::unique_ptr<SkinnedModelData> asset(new SkinnedModelData(filename, scale, settings));
+    if (!asset->cook(output)) {
+        return 1;
+    }
+    
+    std::printf("Cooked %s to %s\n", filename.c_str(), output.c_str());
+    return 0;
+}